@@ -9,7 +9,10 @@
 #include <picoio/time.hpp>
 
 #include <pico.system/native.hpp>
+#include <pico.system/producer_vote_deltas.hpp>
 
+#include <algorithm>
+#include <array>
 #include <deque>
 #include <optional>
 #include <string>
@@ -70,6 +73,7 @@ namespace picoiosystem {
    static constexpr uint32_t refund_delay_sec      = 3 * seconds_per_day;
 
    static constexpr int64_t  inflation_precision           = 100;     // 2 decimals
+   static constexpr uint64_t reward_per_share_precision    = 1'000'000'000'000'000'000ull; // 18 decimals
    static constexpr int64_t  default_annual_rate           = 0;       // 5% annual rate
    static constexpr int64_t  pay_factor_precision          = 10000;
    static constexpr int64_t  default_inflation_pay_factor  = 50000;   // producers pay share = 10000 / 50000 = 20% of the inflation
@@ -144,6 +148,10 @@ namespace picoiosystem {
 
    /**
     * Defines new global state parameters.
+    *
+    * @details Frequently updated counters live in `picoio_global_hot_state` (table `globalhot`) which is
+    * authoritative for them. Their fields here are kept to preserve the layout read by other contracts and
+    * clients, they are refreshed from `globalhot` whenever this record is written and may lag behind between writes.
     */
    struct [[picoio::table("global"), picoio::contract("pico.system")]] picoio_global_state : picoio::blockchain_parameters {
       uint64_t free_ram()const { return max_ram_size - total_ram_bytes_reserved; }
@@ -157,9 +165,41 @@ namespace picoiosystem {
       //producer name and pervote factor
       std::vector<std::pair<picoio::name, double>> last_schedule;
       std::vector<std::pair<picoio::name, double>> standby;
-      uint32_t last_schedule_version = 0;
-      block_timestamp current_round_start_time;
+      uint32_t last_schedule_version = 0; /* mirrored from globalhot */
+      block_timestamp current_round_start_time; /* mirrored from globalhot */
+
+      block_timestamp      last_producer_schedule_update; /* mirrored from globalhot */
+      time_point           last_pervote_bucket_fill; /* mirrored from globalhot */
+      int64_t              perstake_bucket = 0; /* mirrored from globalhot */
+      int64_t              pervote_bucket = 0; /* mirrored from globalhot */
+      int64_t              perblock_bucket = 0; /* mirrored from globalhot */
+      uint32_t             total_unpaid_blocks = 0; /* mirrored from globalhot */
+      int64_t              total_guardians_stake = 0; /* mirrored from globalhot */
+      int64_t              total_activated_stake = 0; /* mirrored from globalhot */
+      time_point           thresh_activated_stake_time;
+      uint16_t             last_producer_schedule_size = 0;
+      double               total_producer_vote_weight = 0; /* mirrored from globalhot */
+      double               total_active_producer_vote_weight = 0; /* mirrored from globalhot */
+      block_timestamp      last_name_close;
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      PICOLIB_SERIALIZE_DERIVED( picoio_global_state, picoio::blockchain_parameters, (core_symbol)(max_ram_size)(min_account_stake)
+                                (total_ram_bytes_reserved)(total_ram_stake)(last_schedule)(standby)(last_schedule_version)
+                                (current_round_start_time) (last_producer_schedule_update)(last_pervote_bucket_fill)
+                                (perstake_bucket)(pervote_bucket)(perblock_bucket)(total_unpaid_blocks)(total_guardians_stake)
+                                (total_activated_stake)(thresh_activated_stake_time)(last_producer_schedule_size)
+                                (total_producer_vote_weight)(total_active_producer_vote_weight)(last_name_close) )
+   };
 
+   /**
+    * Defines frequently updated global counters.
+    *
+    * @details Fixed-size record split out of `picoio_global_state` so that actions updating rewards buckets,
+    * vote weights or round state do not have to serialize producer schedules and blockchain parameters.
+    */
+   struct [[picoio::table("globalhot"), picoio::contract("pico.system")]] picoio_global_hot_state {
+      uint32_t             last_schedule_version = 0;
+      block_timestamp      current_round_start_time;
       block_timestamp      last_producer_schedule_update;
       time_point           last_pervote_bucket_fill;
       int64_t              perstake_bucket = 0;
@@ -168,19 +208,14 @@ namespace picoiosystem {
       uint32_t             total_unpaid_blocks = 0; /// all blocks which have been produced but not paid
       int64_t              total_guardians_stake = 0;
       int64_t              total_activated_stake = 0;
-      time_point           thresh_activated_stake_time;
-      uint16_t             last_producer_schedule_size = 0;
       double               total_producer_vote_weight = 0; /// the sum of all producer votes
       double               total_active_producer_vote_weight = 0; /// the sum of top 21 producer votes
-      block_timestamp      last_name_close;
+      bool                 pervote_shares_changed = true; /// per-vote shares in schedule and standby have to be recomputed
 
-      // explicit serialization macro is not necessary, used here only to improve compilation time
-      PICOLIB_SERIALIZE_DERIVED( picoio_global_state, picoio::blockchain_parameters, (core_symbol)(max_ram_size)(min_account_stake)
-                                (total_ram_bytes_reserved)(total_ram_stake)(last_schedule)(standby)(last_schedule_version)
-                                (current_round_start_time) (last_producer_schedule_update)(last_pervote_bucket_fill)
-                                (perstake_bucket)(pervote_bucket)(perblock_bucket)(total_unpaid_blocks)(total_guardians_stake)
-                                (total_activated_stake)(thresh_activated_stake_time)(last_producer_schedule_size)
-                                (total_producer_vote_weight)(total_active_producer_vote_weight)(last_name_close) )
+      PICOLIB_SERIALIZE( picoio_global_hot_state, (last_schedule_version)(current_round_start_time)
+                        (last_producer_schedule_update)(last_pervote_bucket_fill)(perstake_bucket)(pervote_bucket)
+                        (perblock_bucket)(total_unpaid_blocks)(total_guardians_stake)(total_activated_stake)
+                        (total_producer_vote_weight)(total_active_producer_vote_weight)(pervote_shares_changed) )
    };
 
    /**
@@ -242,10 +277,14 @@ namespace picoiosystem {
 
       microseconds reassertion_period = picoio::days( 30 );
 
+      // cumulative per-stake reward paid to a single unit of guardian stake, scaled by reward_per_share_precision
+      picoio::binary_extension<uint128_t> perstake_reward_per_share;
+
       PICOLIB_SERIALIZE( picoio_global_pico_state, (per_stake_share)(per_vote_share)
                                                 (gifter_attr_contract)(gifter_attr_issuer)(gifter_attr_name)
                                                 (guardian_stake_threshold)(producer_max_inactivity_time)(producer_inactivity_punishment_period)
-                                                (stake_lock_period)(stake_unlock_period)(reassertion_period) )
+                                                (stake_lock_period)(stake_unlock_period)(reassertion_period)
+                                                (perstake_reward_per_share) )
    };
 
    /**
@@ -266,8 +305,109 @@ namespace picoiosystem {
     */
    typedef picoio::singleton< "rotations"_n, rotation_state >   rotation_state_singleton;
 
+   /**
+    * Per-vote reward accumulated by a scheduled or standby producer since it was last settled,
+    * the time of the last produced block is read from the round ledger or the producer counters
+    */
+   struct pervote_reward_slot {
+      name         producer;
+      int64_t      unsettled_reward = 0;
+
+      PICOLIB_SERIALIZE( pervote_reward_slot, (producer)(unsettled_reward) )
+   };
+
+   /**
+    * Defines per-vote reward slots of the producers from `last_schedule` followed by the producers from `standby`,
+    * rewards are moved to `producer_counters::pending_pervote_reward` on claim or when a producer leaves the slots
+    */
+   struct [[picoio::table("pervotepay"), picoio::contract("pico.system")]] pervote_reward_state {
+      std::vector<pervote_reward_slot> slots;
+
+      PICOLIB_SERIALIZE( pervote_reward_state, (slots) )
+   };
+
+   typedef picoio::singleton< "pervotepay"_n, pervote_reward_state >   pervote_reward_singleton;
+
+   /**
+    * Block production counters of a scheduled producer which are not yet settled into its `producer_info`
+    */
+   struct round_ledger_slot {
+      name              producer;
+      uint32_t          current_round_unpaid_blocks = 0;
+      uint32_t          unpaid_blocks = 0; //count blocks only from finished rounds
+      uint32_t          expected_produced_blocks = 0;
+      block_timestamp   last_expected_produced_blocks_update;
+      time_point        last_block_time;
+
+      PICOLIB_SERIALIZE( round_ledger_slot, (producer)(current_round_unpaid_blocks)(unpaid_blocks)
+                        (expected_produced_blocks)(last_expected_produced_blocks_update)(last_block_time) )
+   };
+
+   /**
+    * Defines round ledger slots indexed by producer position in `last_schedule`,
+    * counters are moved to `producer_counters` on claim or when a producer leaves the schedule
+    */
+   struct [[picoio::table("roundledger"), picoio::contract("pico.system")]] round_ledger_state {
+      std::vector<round_ledger_slot> slots;
+
+      PICOLIB_SERIALIZE( round_ledger_state, (slots) )
+   };
+
+   typedef picoio::singleton< "roundledger"_n, round_ledger_state >   round_ledger_singleton;
+
+   /**
+    * Defines the state of the last producer schedule computation in `update_elected_producers`
+    *
+    * @details `inputs_digest` is a hash of the rotation state, `last_schedule` and `last_producer_schedule_size`
+    * the last computation started from, `producers_changed` is set whenever producer votes or registrations change.
+    * If neither changed and no rotation is due, the computation would give the same result and is skipped.
+    */
+   struct [[picoio::table("scheddigest"), picoio::contract("pico.system")]] schedule_digest_state {
+      bool          producers_changed = true;
+      checksum256   inputs_digest;
+
+      PICOLIB_SERIALIZE( schedule_digest_state, (producers_changed)(inputs_digest) )
+   };
+
+   typedef picoio::singleton< "scheddigest"_n, schedule_digest_state >   schedule_digest_singleton;
+
+   /**
+    * Defines a producer entry of the producer ranking
+    */
+   struct ranked_producer {
+      name     owner;
+      double   total_votes = 0;
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      PICOLIB_SERIALIZE( ranked_producer, (owner)(total_votes) )
+   };
+
+   /**
+    * Defines the ranking of active producers with positive votes, used to pick top21 and standby producers
+    *
+    * @details `producers` are the exact top of the `prototalvote` index, ordered the same way, and are kept
+    * up to date whenever producer votes or activity change. Only names and votes are kept, so that vote changes
+    * rewrite a small singleton, authorities of the chosen producers are read from the producers table.
+    * At most `max_ranked_producers` are kept,
+    * `truncated` is set when some ranked producers may be missing below the last one,
+    * in this case the ranking is rebuilt from the index once it gets shorter than rotation needs.
+    */
+   struct [[picoio::table("prodranking"), picoio::contract("pico.system")]] producer_ranking_state {
+      static constexpr uint32_t max_ranked_producers = 50;
+
+      std::vector<ranked_producer> producers;
+      bool                         truncated = false;
+
+      PICOLIB_SERIALIZE( producer_ranking_state, (producers)(truncated) )
+   };
+
+   typedef picoio::singleton< "prodranking"_n, producer_ranking_state >   producer_ranking_singleton;
+
    /**
     * Defines `producer_info` structure to be stored in `producer_info` table, added after version 1.0
+    *
+    * @details Block and reward counters are kept in `producer_counters` (table `prodcounters`) which is
+    * authoritative for them, their fields here are zeroed when a producer is migrated.
     */
    struct [[picoio::table, picoio::contract("pico.system")]] producer_info {
       name                  owner;
@@ -275,13 +415,13 @@ namespace picoiosystem {
       picoio::public_key     producer_key; /// a packed public key object
       bool                  is_active = true;
       std::string           url;
-      uint32_t              current_round_unpaid_blocks = 0;
-      uint32_t              unpaid_blocks = 0; //count blocks only from finished rounds
-      uint32_t              expected_produced_blocks = 0;
-      block_timestamp       last_expected_produced_blocks_update;
-      int64_t               pending_pervote_reward = 0;
+      uint32_t              current_round_unpaid_blocks = 0; /* moved to prodcounters, zero once migrated */
+      uint32_t              unpaid_blocks = 0; /* moved to prodcounters, zero once migrated */
+      uint32_t              expected_produced_blocks = 0; /* moved to prodcounters, zero once migrated */
+      block_timestamp       last_expected_produced_blocks_update; /* moved to prodcounters, zero once migrated */
+      int64_t               pending_pervote_reward = 0; /* moved to prodcounters, zero once migrated */
       time_point            last_claim_time;
-      time_point            last_block_time;
+      time_point            last_block_time; /* moved to prodcounters, zero once migrated */
       time_point            top21_chosen_time;
       time_point            punished_until;
       uint16_t              location = 0;
@@ -299,6 +439,28 @@ namespace picoiosystem {
                         (punished_until)(location)(producer_authority) )
    };
 
+   /**
+    * Defines block and reward counters of a producer, updated by `onblock` and `claimrewards`
+    *
+    * @details Counters were moved out of `producer_info`, so producing blocks does not rewrite producer url and authority.
+    * Values left in `producer_info` are only read to create the counters of producers that were not migrated yet.
+    */
+   struct [[picoio::table, picoio::contract("pico.system")]] producer_counters {
+      name              owner;
+      uint32_t          current_round_unpaid_blocks = 0;
+      uint32_t          unpaid_blocks = 0; //count blocks only from finished rounds
+      uint32_t          expected_produced_blocks = 0;
+      block_timestamp   last_expected_produced_blocks_update;
+      int64_t           pending_pervote_reward = 0;
+      time_point        last_block_time;
+
+      uint64_t primary_key()const { return owner.value; }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      PICOLIB_SERIALIZE( producer_counters, (owner)(current_round_unpaid_blocks)(unpaid_blocks)(expected_produced_blocks)
+                        (last_expected_produced_blocks_update)(pending_pervote_reward)(last_block_time) )
+   };
+
    /**
     * Defines new producer info structure to be stored in new producer info table, added after version 1.3.0
     */
@@ -320,15 +482,17 @@ namespace picoiosystem {
     * - `owner` the voter
     * - `proxy` the proxy set by the voter, if any
     * - `producers` the producers approved by this voter if no proxy set
-    * - `staked` the amount staked
+    *
+    * Stake, lock and reward fields are kept in `voter_stake` (table `voterstakes`) which is authoritative for them,
+    * their fields here are zeroed when a voter is migrated.
     */
    struct [[picoio::table, picoio::contract("pico.system")]] voter_info {
    public:
       name                owner;     /// the voter
       name                proxy;     /// the proxy set by the voter, if any
       std::vector<name>   producers; /// the producers approved by this voter if no proxy set
-      int64_t             staked = 0;
-      int64_t             locked_stake = 0;
+      int64_t             staked = 0; /* moved to voterstakes, zero once migrated */
+      int64_t             locked_stake = 0; /* moved to voterstakes, zero once migrated */
 
       double by_stake() const { return staked; }
 
@@ -339,7 +503,7 @@ namespace picoiosystem {
        *  stated.amount * 2 ^ ( weeks_since_launch/weeks_per_year)
        */
       double              last_vote_weight = 0; /// the vote weight cast the last time the vote was updated
-      time_point          stake_lock_time;
+      time_point          stake_lock_time; /* moved to voterstakes, zero once migrated */
       time_point          last_undelegate_time;
 
       /**
@@ -361,9 +525,9 @@ namespace picoiosystem {
          cpu_managed = 4
       };
 
-      time_point          last_reassertion_time;
-      int64_t             pending_perstake_reward = 0;
-      time_point          last_claim_time;
+      time_point          last_reassertion_time; /* moved to voterstakes, zero once migrated */
+      int64_t             pending_perstake_reward = 0; /// legacy, rewards are accumulated in `guardian_info` rows
+      time_point          last_claim_time; /* moved to voterstakes, zero once migrated */
 
 
       // explicit serialization macro is not necessary, used here only to improve compilation time
@@ -372,6 +536,62 @@ namespace picoiosystem {
                                     (last_reassertion_time)(pending_perstake_reward)(last_claim_time) )
    };
 
+   /**
+    * Voter stake.
+    *
+    * @details Stake, lock and reward fields of a voter, kept apart from `voter_info` so that stake changes,
+    * reward claims and guardian updates do not rewrite the list of approved producers. A voter stake row stores:
+    * - `owner` the voter
+    * - `staked` the amount staked
+    * - `locked_stake` the amount staked including stake that is not used for voting yet
+    * - `stake_lock_time` the time the stake is locked until
+    * - `last_reassertion_time` the last time the voter cast a vote, used to expire the guardian status
+    * - `last_claim_time` the last time the voter claimed per-stake rewards
+    *
+    * Values left in `voter_info` are only read to create the stake row of a voter that was not migrated yet,
+    * and are zeroed afterwards.
+    */
+   struct [[picoio::table, picoio::contract("pico.system")]] voter_stake {
+      name                owner;
+      int64_t             staked = 0;
+      int64_t             locked_stake = 0;
+      time_point          stake_lock_time;
+      time_point          last_reassertion_time;
+      time_point          last_claim_time;
+
+      uint64_t primary_key()const { return owner.value; }
+      double   by_stake()const    { return staked; }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      PICOLIB_SERIALIZE( voter_stake, (owner)(staked)(locked_stake)(stake_lock_time)(last_reassertion_time)(last_claim_time) )
+   };
+
+   /**
+    * Guardian info.
+    *
+    * @details Per-stake rewards are distributed lazily: `torewards` only advances the global
+    * `perstake_reward_per_share` accumulator and every guardian settles its share when its stake changes
+    * or when it claims rewards. A guardian info row stores:
+    * - `owner` the voter
+    * - `guardian_stake` the stake that earns per-stake rewards, zero if the voter is not a guardian
+    * - `reward_per_share` the value of the accumulator at the moment the row was last settled
+    * - `pending_reward` the settled reward that was not claimed yet
+    * - `last_reassertion_time` the last vote reassertion of the voter, used to expire the guardian status
+    */
+   struct [[picoio::table, picoio::contract("pico.system")]] guardian_info {
+      name                owner;
+      int64_t             guardian_stake = 0;
+      uint128_t           reward_per_share = 0;
+      int64_t             pending_reward = 0;
+      time_point          last_reassertion_time;
+
+      uint64_t primary_key()const     { return owner.value; }
+      uint64_t by_reassertion()const  { return guardian_stake > 0 ? last_reassertion_time.elapsed.count() : std::numeric_limits<uint64_t>::max(); }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      PICOLIB_SERIALIZE( guardian_info, (owner)(guardian_stake)(reward_per_share)(pending_reward)(last_reassertion_time) )
+   };
+
    struct [[picoio::table, picoio::contract("pico.system")]] user_resources {
       name          owner;
       asset         net_weight;
@@ -419,11 +639,48 @@ namespace picoiosystem {
     * Voters table
     *
     * @details The voters table stores all the `voter_info`s instances, all voters information.
+    * Its `bystake` index only orders voters that were not migrated yet, use the `voterstakes` index to order voters by stake.
+    * The index is kept so that secondary index rows already stored on chain are maintained on modify and erase.
     */
    typedef picoio::multi_index< "voters"_n, voter_info,
                                indexed_by<"bystake"_n, const_mem_fun<voter_info, double, &voter_info::by_stake> >
                              > voters_table;
 
+   /**
+    * Voter stakes table
+    *
+    * @details The voter stakes table stores `voter_stake` instances, the frequently updated part of voters information.
+    */
+   typedef picoio::multi_index< "voterstakes"_n, voter_stake,
+                               indexed_by<"bystake"_n, const_mem_fun<voter_stake, double, &voter_stake::by_stake> >
+                             > voter_stakes_table;
+
+   /**
+    * Guardians table
+    *
+    * @details The guardians table stores per-stake reward checkpoints of the voters that are or were guardians,
+    * indexed by the last vote reassertion so that lapsed guardians can be found without scanning all voters.
+    */
+   typedef picoio::multi_index< "guardians"_n, guardian_info,
+                               indexed_by<"byreassert"_n, const_mem_fun<guardian_info, uint64_t, &guardian_info::by_reassertion> >
+                             > guardians_table;
+
+   /**
+    * Defines the guardian stake rescan started by `setgrdthresh`
+    *
+    * @details Only voters with stake in `[lower, upper)` can change their guardian status when the threshold moves
+    * between `lower` and `upper`. They are updated in bounded batches in the order of voter names, `cursor` is
+    * the first voter of the next batch. No rescan is pending while `lower >= upper`.
+    */
+   struct [[picoio::table("grdrescan"), picoio::contract("pico.system")]] guardian_rescan_state {
+      int64_t   lower = 0;
+      int64_t   upper = 0;
+      name      cursor;
+
+      PICOLIB_SERIALIZE( guardian_rescan_state, (lower)(upper)(cursor) )
+   };
+
+   typedef picoio::singleton< "grdrescan"_n, guardian_rescan_state >   guardian_rescan_singleton;
 
    /**
     * Defines producer info table added in version 1.0
@@ -436,10 +693,19 @@ namespace picoiosystem {
     */
    typedef picoio::multi_index< "producers2"_n, producer_info2 > producers_table2;
 
+   /**
+    * Defines producer counters table
+    */
+   typedef picoio::multi_index< "prodcounters"_n, producer_counters > producer_counters_table;
+
    /**
     * Global state singleton added in version 1.0
     */
    typedef picoio::singleton< "global"_n, picoio_global_state >   global_state_singleton;
+   /**
+    * Global frequently updated counters singleton, split out of global state
+    */
+   typedef picoio::singleton< "globalhot"_n, picoio_global_hot_state > global_hot_state_singleton;
    /**
     * Global state singleton added in version 1.1.0
     */
@@ -513,25 +779,151 @@ namespace picoiosystem {
     */
    typedef picoio::multi_index< "rexfund"_n, rex_fund > rex_fund_table;
 
+   /**
+    * REX maturity buckets of a rex balance.
+    *
+    * @details REX matures at the start of a day at most `max_buckets` days ahead, so buckets are kept
+    * as amounts of consecutive days starting from `base_day`:
+    * - `base_day` the day of the first bucket, in days since epoch,
+    * - `amounts` REX maturing at the start of day `base_day + i`, at most `max_buckets` entries,
+    * - `savings` REX in savings, it never matures.
+    */
+   struct rex_maturity_ring {
+      static constexpr uint32_t max_buckets = 5;
+
+      uint32_t              base_day = 0;
+      std::vector<int64_t>  amounts;
+      int64_t               savings = 0;
+
+      static uint32_t day_of( const time_point_sec& t ) { return t.sec_since_epoch() / seconds_per_day; }
+
+      /// number of leading buckets that matured by the `today` day
+      uint32_t matured_buckets( uint32_t today )const {
+         return today < base_day ? 0 : std::min<uint32_t>( today - base_day + 1, amounts.size() );
+      }
+
+      /// removes matured buckets and returns the REX they held
+      int64_t take_matured( uint32_t today ) {
+         const uint32_t matured = matured_buckets( today );
+         int64_t total = 0;
+         for ( uint32_t i = 0; i < matured; ++i ) {
+            total += amounts[i];
+         }
+         amounts.erase( amounts.begin(), amounts.begin() + matured );
+         base_day += matured;
+         return total;
+      }
+
+      /// removes up to `max` REX starting from the latest bucket and returns the removed amount
+      int64_t take_latest( int64_t max ) {
+         int64_t total = 0;
+         while ( !amounts.empty() && total < max ) {
+            const int64_t drex = std::min( max - total, amounts.back() );
+            amounts.back() -= drex;
+            total          += drex;
+            if ( amounts.back() == 0 ) {
+               amounts.pop_back();
+            }
+         }
+         return total;
+      }
+
+      /// removes all buckets and returns the REX they held
+      int64_t take_all() {
+         int64_t total = 0;
+         for ( const auto amount: amounts ) {
+            total += amount;
+         }
+         amounts.clear();
+         return total;
+      }
+
+      void add( const time_point_sec& maturity, int64_t amount ) {
+         const uint32_t day = day_of( maturity );
+         if ( amounts.empty() ) {
+            base_day = day;
+         }
+         picoio::check( base_day <= day && day - base_day < max_buckets, "REX maturity is out of maturity buckets range" );
+         if ( day - base_day >= amounts.size() ) {
+            amounts.resize( day - base_day + 1 );
+         }
+         amounts[day - base_day] += amount;
+      }
+
+      /**
+       * Converts maturity buckets of a legacy rex balance, in which savings is the bucket maturing at `time_point_sec::maximum()`.
+       * Buckets too early to fit before the latest one matured long ago and are added to `matured_rex`.
+       */
+      static rex_maturity_ring from_legacy( const std::deque<std::pair<time_point_sec, int64_t>>& legacy, int64_t& matured_rex ) {
+         rex_maturity_ring ring;
+         auto last = legacy.end();
+         if ( last != legacy.begin() && std::prev( last )->first == time_point_sec::maximum() ) {
+            --last;
+            ring.savings = last->second;
+         }
+         if ( last == legacy.begin() ) {
+            return ring;
+         }
+
+         const uint32_t last_day = day_of( std::prev( last )->first );
+         const uint32_t first_day = last_day + 1 >= max_buckets ? last_day + 1 - max_buckets : 0;
+         for ( auto it = legacy.begin(); it != last; ++it ) {
+            if ( day_of( it->first ) < first_day ) {
+               matured_rex += it->second;
+            } else {
+               ring.add( it->first, it->second );
+            }
+         }
+         return ring;
+      }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      PICOLIB_SERIALIZE( rex_maturity_ring, (base_day)(amounts)(savings) )
+   };
+
    /**
     * `rex_balance` structure underlying the rex balance table.
     *
     * @details A rex balance table entry is defined by:
-    * - `version` defaulted to zero,
+    * - `version` the version of the entry layout, entries are rewritten in the current one when modified,
     * - `owner` the owner of the rex fund,
     * - `vote_stake` the amount of CORE_SYMBOL currently included in owner's vote,
     * - `rex_balance` the amount of REX owned by owner,
-    * - `matured_rex` matured REX available for selling.
+    * - `matured_rex` matured REX available for selling,
+    * - `rex_maturities` REX maturing within next days and REX in savings.
+    *
+    * Version 0 entries stored maturities as a list of `(maturity, amount)` pairs and are converted when read.
+    * The ABI describes only the current layout, version 0 entries are rewritten by `migrrexbal`.
     */
    struct [[picoio::table,picoio::contract("pico.system")]] rex_balance {
-      uint8_t version = 0;
+      static constexpr uint8_t current_version = 1;
+
+      uint8_t version = current_version;
       name    owner;
       asset   vote_stake;
       asset   rex_balance;
       int64_t matured_rex = 0;
-      std::deque<std::pair<time_point_sec, int64_t>> rex_maturities; /// REX daily maturity buckets
+      rex_maturity_ring rex_maturities; /// REX daily maturity buckets
 
       uint64_t primary_key()const { return owner.value; }
+
+      template<typename DataStream>
+      friend DataStream& operator<<( DataStream& ds, const rex_balance& rb ) {
+         return ds << current_version << rb.owner << rb.vote_stake << rb.rex_balance << rb.matured_rex << rb.rex_maturities;
+      }
+
+      template<typename DataStream>
+      friend DataStream& operator>>( DataStream& ds, rex_balance& rb ) {
+         ds >> rb.version >> rb.owner >> rb.vote_stake >> rb.rex_balance >> rb.matured_rex;
+         if ( rb.version == 0 ) {
+            std::deque<std::pair<time_point_sec, int64_t>> legacy;
+            ds >> legacy;
+            rb.rex_maturities = rex_maturity_ring::from_legacy( legacy, rb.matured_rex );
+         } else {
+            ds >> rb.rex_maturities;
+         }
+         return ds;
+      }
    };
 
    /**
@@ -566,30 +958,58 @@ namespace picoiosystem {
       picoio::time_point   expiration;
 
       uint64_t primary_key()const { return loan_num;                   }
-      uint64_t by_expr()const     { return expiration.elapsed.count(); }
       uint64_t by_owner()const    { return from.value;                 }
    };
 
    /**
     * Rex cpu loan table
     *
-    * @details The rex cpu loan table is storing all the `rex_loan`s instances for cpu, indexed by loan number, expiration and owner.
+    * @details The rex cpu loan table is storing all the `rex_loan`s instances for cpu, indexed by loan number and owner.
     */
    typedef picoio::multi_index< "cpuloan"_n, rex_loan,
-                               indexed_by<"byexpr"_n,  const_mem_fun<rex_loan, uint64_t, &rex_loan::by_expr>>,
                                indexed_by<"byowner"_n, const_mem_fun<rex_loan, uint64_t, &rex_loan::by_owner>>
                              > rex_cpu_loan_table;
 
    /**
     * Rex net loan table
     *
-    * @details The rex net loan table is storing all the `rex_loan`s instances for net, indexed by loan number, expiration and owner.
+    * @details The rex net loan table is storing all the `rex_loan`s instances for net, indexed by loan number and owner.
     */
    typedef picoio::multi_index< "netloan"_n, rex_loan,
-                               indexed_by<"byexpr"_n,  const_mem_fun<rex_loan, uint64_t, &rex_loan::by_expr>>,
                                indexed_by<"byowner"_n, const_mem_fun<rex_loan, uint64_t, &rex_loan::by_owner>>
                              > rex_net_loan_table;
 
+   /**
+    * `rex_loan_bucket` structure underlying the `rex_loan_bucket_table`.
+    *
+    * @details Loans are grouped by expiration into hourly buckets, a bucket is defined by:
+    * - `expiration` the end of the hour all loans of the bucket expire within,
+    * - `loan_nums` numbers of the loans.
+    * Buckets are processed only after all their loans expired, and a renewed loan moves to the bucket of its new expiration.
+    */
+   struct [[picoio::table,picoio::contract("pico.system")]] rex_loan_bucket {
+      static constexpr int64_t granularity = 3600ll * 1000'000ll; /// one hour in microseconds
+
+      picoio::time_point      expiration;
+      std::vector<uint64_t>  loan_nums;
+
+      uint64_t primary_key()const { return expiration.elapsed.count(); }
+
+      static picoio::time_point bucket_expiration( const picoio::time_point& loan_expiration ) {
+         return picoio::time_point{ picoio::microseconds{ ( loan_expiration.elapsed.count() + granularity - 1 ) / granularity * granularity } };
+      }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      PICOLIB_SERIALIZE( rex_loan_bucket, (expiration)(loan_nums) )
+   };
+
+   /**
+    * Rex loan bucket table
+    *
+    * @details The rex loan bucket table is storing `rex_loan_bucket`s instances of a loan table, which name is the scope.
+    */
+   typedef picoio::multi_index< "loanbuckets"_n, rex_loan_bucket > rex_loan_bucket_table;
+
    struct [[picoio::table,picoio::contract("pico.system")]] rex_order {
       uint8_t             version = 0;
       name                owner;
@@ -618,6 +1038,92 @@ namespace picoiosystem {
       asset stake_change;
    };
 
+   /**
+    * Number of due REX maintenance rows in each queue, counted up to a limit
+    */
+   struct rex_backlog {
+      uint32_t cpu_loans = 0;
+      uint32_t net_loans = 0;
+      uint32_t sell_orders = 0;
+
+      uint32_t deepest()const { return std::max( { cpu_loans, net_loans, sell_orders } ); }
+   };
+
+   /**
+    * Defines the state of REX maintenance done by `rexexec` and by REX user actions
+    *
+    * @details User actions process at most `user_max` rows of each queue, and only when some queue has more than
+    * `user_backlog_threshold` due rows, the rest is left to `rexexec`. `sell_order_cursor` is the `bytime` key
+    * of the sell order the next pass starts from, so sell orders that can not be filled do not block the ones behind them.
+    * Backlog depths are counted after every `rexexec` up to `rex_backlog_scan_limit` rows.
+    */
+   struct [[picoio::table("rexmaint"), picoio::contract("pico.system")]] rex_maintenance_state {
+      static constexpr uint32_t rex_backlog_scan_limit = 100;
+
+      uint16_t     user_backlog_threshold = 0;
+      uint16_t     user_max = 2;
+      uint64_t     sell_order_cursor = 0;
+      uint32_t     cpu_loan_backlog = 0;
+      uint32_t     net_loan_backlog = 0;
+      uint32_t     sell_order_backlog = 0;
+      time_point   last_run_time;
+
+      PICOLIB_SERIALIZE( rex_maintenance_state, (user_backlog_threshold)(user_max)(sell_order_cursor)
+                         (cpu_loan_backlog)(net_loan_backlog)(sell_order_backlog)(last_run_time) )
+   };
+
+   typedef picoio::singleton< "rexmaint"_n, rex_maintenance_state >   rex_maintenance_singleton;
+
+   /**
+    * Lazily loaded and write-back cached singleton value.
+    *
+    * @details The value is read from the singleton on the first access only and is written back by `save`
+    * only if it was accessed through `modify`, so actions that never touch a singleton pay neither for its
+    * deserialization nor for its serialization. A singleton that does not exist yet is initialized
+    * with `make_default` and is saved on the first access.
+    */
+   template <typename Singleton, typename T>
+   class singleton_cache {
+      public:
+         singleton_cache( name code, uint64_t scope, T (*make_default)() )
+         :_singleton(code, scope), _make_default(make_default) {}
+
+         const T& get()const {
+            if ( !_value ) {
+               if ( _singleton.exists() ) {
+                  _value = _singleton.get();
+               } else {
+                  _value = _make_default();
+                  _dirty = true;
+               }
+            }
+            return *_value;
+         }
+
+         T& modify() {
+            get();
+            _dirty = true;
+            return *_value;
+         }
+
+         const T* operator->()const { return &get(); }
+
+         bool dirty()const { return _dirty; }
+
+         void save( name payer ) {
+            if ( _dirty ) {
+               _singleton.set( *_value, payer );
+               _dirty = false;
+            }
+         }
+
+      private:
+         mutable Singleton        _singleton;
+         T                        (*_make_default)();
+         mutable std::optional<T> _value;
+         mutable bool             _dirty = false;
+   };
+
    /**
     * The PICOIO system contract.
     *
@@ -627,25 +1133,29 @@ namespace picoiosystem {
 
       private:
          voters_table            _voters;
+         voter_stakes_table      _voter_stakes;
+         guardians_table         _guardians;
          producers_table         _producers;
          producers_table2        _producers2;
-         global_state_singleton  _global;
-         global_state2_singleton _global2;
-         global_state3_singleton _global3;
-         global_state4_singleton _global4;
-         global_pico_state_singleton _globalpico;
-         picoio_global_state      _gstate;
-         picoio_global_state2     _gstate2;
-         picoio_global_state3     _gstate3;
-         picoio_global_state4     _gstate4;
-         picoio_global_pico_state  _gpicostate;
+         producer_counters_table _producer_counters;
+         singleton_cache<global_state_singleton, picoio_global_state>          _gstate;
+         singleton_cache<global_hot_state_singleton, picoio_global_hot_state>  _ghotstate;
+         singleton_cache<global_state2_singleton, picoio_global_state2>        _gstate2;
+         singleton_cache<global_state3_singleton, picoio_global_state3>        _gstate3;
+         singleton_cache<global_state4_singleton, picoio_global_state4>        _gstate4;
+         singleton_cache<global_pico_state_singleton, picoio_global_pico_state> _gpicostate;
          rex_pool_table          _rexpool;
          rex_fund_table          _rexfunds;
          rex_balance_table       _rexbalance;
          rex_order_table         _rexorders;
 
-         rotation_state_singleton _rotation;
-         rotation_state           _grotation;
+         singleton_cache<rotation_state_singleton, rotation_state>             _grotation;
+         singleton_cache<pervote_reward_singleton, pervote_reward_state>       _gpervotepay;
+         singleton_cache<round_ledger_singleton, round_ledger_state>           _groundledger;
+         singleton_cache<schedule_digest_singleton, schedule_digest_state>     _gscheddigest;
+         singleton_cache<producer_ranking_singleton, producer_ranking_state>   _gprodranking;
+         singleton_cache<rex_maintenance_singleton, rex_maintenance_state>     _grexmaint;
+         singleton_cache<guardian_rescan_singleton, guardian_rescan_state>     _ggrdrescan;
 
       public:
          static constexpr picoio::name active_permission{"active"_n};
@@ -712,6 +1222,9 @@ namespace picoiosystem {
        [[picoio::action]]
        void punishprod( const name& producer );
 
+       [[picoio::action]]
+       void setgrdthresh( int64_t threshold );
+
 
         // Actions:
         /**
@@ -972,6 +1485,32 @@ namespace picoiosystem {
          [[picoio::action]]
          void rentnet( const name& from, const name& receiver, const asset& loan_payment, const asset& loan_fund );
 
+         /**
+          * Quoterent action.
+          *
+          * @details Prices a CPU or NET loan at the current market price without changing any state.
+          * Rented tokens are reported through the `rentquote` action of `rex.results`. The quote fails
+          * like `rentcpu` and `rentnet` do when the loan price does not favor renting. Maintenance that
+          * `rentcpu` and `rentnet` may run first is not simulated.
+          *
+          * @param loan_payment - tokens that would be paid for the loan, it has to be greater than zero.
+          */
+         [[picoio::action]]
+         void quoterent( const asset& loan_payment );
+
+         /**
+          * Quotesell action.
+          *
+          * @details Prices a sellrex order at the current exchange rate without changing any state.
+          * Proceeds, vote stake change and whether the order would be queued are reported through
+          * the `sellquote` action of `rex.results`. Maintenance that `sellrex` may run first is not simulated.
+          *
+          * @param owner - owner account of REX,
+          * @param rex - amount of REX that would be sold.
+          */
+         [[picoio::action]]
+         void quotesell( const name& owner, const asset& rex );
+
          /**
           * Fundcpuloan action.
           *
@@ -1036,7 +1575,8 @@ namespace picoiosystem {
           * Rexexec action.
           *
           * @details Processes max CPU loans, max NET loans, and max queued sellrex orders.
-          * Action does not execute anything related to a specific user.
+          * Action does not execute anything related to a specific user. Remaining backlog of each queue
+          * is recorded in the `rexmaint` singleton.
           *
           * @param user - any account can execute this action,
           * @param max - number of each of CPU loans, NET loans, and sell orders to be processed.
@@ -1044,6 +1584,17 @@ namespace picoiosystem {
          [[picoio::action]]
          void rexexec( const name& user, uint16_t max );
 
+         /**
+          * Set REX maintenance action.
+          *
+          * @details Sets how much REX maintenance is done by REX user actions, such as `buyrex` or `rentcpu`.
+          *
+          * @param backlog_threshold - user actions process due rows only when some queue has more due rows than this,
+          * @param max - number of each of CPU loans, NET loans, and sell orders processed by a user action.
+          */
+         [[picoio::action]]
+         void setrexmaint( uint16_t backlog_threshold, uint16_t max );
+
          /**
           * Consolidate action.
           *
@@ -1254,7 +1805,7 @@ namespace picoiosystem {
           * @pre Every listed producer or proxy must have been previously registered
           * @pre Voter must authorize this action
           * @pre Voter must have previously staked some PICO for voting
-          * @pre Voter->staked must be up to date
+          * @pre Voter stake row must be up to date
           *
           * @post Every producer previously voted for will have vote reduced by previous vote weight
           * @post Every producer newly voted for will have vote increased by new vote amount
@@ -1313,6 +1864,77 @@ namespace picoiosystem {
          [[picoio::action]]
          void torewards( const name& payer, const asset& amount );
 
+         /**
+          * Migrate per-stake rewards action.
+          *
+          * @details Folds `pending_perstake_reward` of at most `max` voters, starting from `from`,
+          * into their guardian reward checkpoints and registers the stake of current guardians.
+          * Has to be executed repeatedly after the upgrade until all voters are migrated. Until then per-stake
+          * rewards are distributed by a scan over all guardians as before the upgrade, so every guardian is paid
+          * whether it was migrated or not.
+          * @param from - first voter to migrate,
+          * @param max - maximum number of voters to migrate.
+          */
+         [[picoio::action]]
+         void migrperstake( const name& from, uint16_t max );
+
+         /**
+          * Migrate global state action.
+          *
+          * @details Moves frequently updated counters from `global` into the `globalhot` singleton.
+          * Has to be executed once after the upgrade, before that the counters are copied implicitly
+          * by the first action that accesses them.
+          */
+         [[picoio::action]]
+         void migrglobal();
+
+         /**
+          * Migrate producer counters action.
+          *
+          * @details Moves block and reward counters of at most `max` producers, starting from `producer`,
+          * from the producers table into the producer counters table. Counters of producers that are not
+          * migrated yet are moved implicitly by the first action that updates them.
+          * @param producer - first producer to migrate,
+          * @param max - maximum number of producers to migrate.
+          */
+         [[picoio::action]]
+         void migrprodctrs( const name& producer, uint16_t max );
+
+         /**
+          * Migrate voter stakes action.
+          *
+          * @details Moves stake, lock and reward fields of at most `max` voters, starting from `from`,
+          * from the voters table into the voter stakes table. Fields of voters that are not migrated yet
+          * are moved implicitly by the first action that updates them, but `setgrdthresh` only sees migrated voters,
+          * so this action has to be executed repeatedly after the upgrade until all voters are migrated.
+          * @param from - first voter to migrate,
+          * @param max - maximum number of voters to migrate.
+          */
+         [[picoio::action]]
+         void migrvoters( const name& from, uint16_t max );
+
+         /**
+          * Migrate REX balances action.
+          *
+          * @details Rewrites at most `max` REX balance entries, starting from `from`, that are still stored
+          * in version 0 layout in the current one. The contract ABI describes only the current layout,
+          * so this action has to be executed repeatedly after the upgrade until no version 0 entries are left.
+          * @param from - owner of the first REX balance entry to migrate,
+          * @param max - maximum number of REX balance entries to migrate.
+          */
+         [[picoio::action]]
+         void migrrexbal( const name& from, uint16_t max );
+
+         /**
+          * Update guardians action.
+          *
+          * @details Continues the guardian stake rescan started by `setgrdthresh` for at most `max` voters.
+          * The rescan also advances by itself in small batches on block, this action only speeds it up.
+          * @param max - maximum number of voters to check.
+          */
+         [[picoio::action]]
+         void updguardians( uint16_t max );
+
          /**
           * Set privilege status for an account.
           *
@@ -1424,12 +2046,15 @@ namespace picoiosystem {
          using cnclrexorder_action = picoio::action_wrapper<"cnclrexorder"_n, &system_contract::cnclrexorder>;
          using rentcpu_action = picoio::action_wrapper<"rentcpu"_n, &system_contract::rentcpu>;
          using rentnet_action = picoio::action_wrapper<"rentnet"_n, &system_contract::rentnet>;
+         using quoterent_action = picoio::action_wrapper<"quoterent"_n, &system_contract::quoterent>;
+         using quotesell_action = picoio::action_wrapper<"quotesell"_n, &system_contract::quotesell>;
          using fundcpuloan_action = picoio::action_wrapper<"fundcpuloan"_n, &system_contract::fundcpuloan>;
          using fundnetloan_action = picoio::action_wrapper<"fundnetloan"_n, &system_contract::fundnetloan>;
          using defcpuloan_action = picoio::action_wrapper<"defcpuloan"_n, &system_contract::defcpuloan>;
          using defnetloan_action = picoio::action_wrapper<"defnetloan"_n, &system_contract::defnetloan>;
          using updaterex_action = picoio::action_wrapper<"updaterex"_n, &system_contract::updaterex>;
          using rexexec_action = picoio::action_wrapper<"rexexec"_n, &system_contract::rexexec>;
+         using setrexmaint_action = picoio::action_wrapper<"setrexmaint"_n, &system_contract::setrexmaint>;
          using setrex_action = picoio::action_wrapper<"setrex"_n, &system_contract::setrex>;
          using mvtosavings_action = picoio::action_wrapper<"mvtosavings"_n, &system_contract::mvtosavings>;
          using mvfrsavings_action = picoio::action_wrapper<"mvfrsavings"_n, &system_contract::mvfrsavings>;
@@ -1448,6 +2073,12 @@ namespace picoiosystem {
          using regproxy_action = picoio::action_wrapper<"regproxy"_n, &system_contract::regproxy>;
          using claimrewards_action = picoio::action_wrapper<"claimrewards"_n, &system_contract::claimrewards>;
          using torewards_action = picoio::action_wrapper<"torewards"_n, &system_contract::torewards>;
+         using migrperstake_action = picoio::action_wrapper<"migrperstake"_n, &system_contract::migrperstake>;
+         using migrglobal_action = picoio::action_wrapper<"migrglobal"_n, &system_contract::migrglobal>;
+         using migrprodctrs_action = picoio::action_wrapper<"migrprodctrs"_n, &system_contract::migrprodctrs>;
+         using migrvoters_action = picoio::action_wrapper<"migrvoters"_n, &system_contract::migrvoters>;
+         using migrrexbal_action = picoio::action_wrapper<"migrrexbal"_n, &system_contract::migrrexbal>;
+         using updguardians_action = picoio::action_wrapper<"updguardians"_n, &system_contract::updguardians>;
 
          using rmvproducer_action = picoio::action_wrapper<"rmvproducer"_n, &system_contract::rmvproducer>;
          using updtrevision_action = picoio::action_wrapper<"updtrevision"_n, &system_contract::updtrevision>;
@@ -1459,6 +2090,7 @@ namespace picoiosystem {
          using setrwrdratio_action = picoio::action_wrapper<"setrwrdratio"_n, &system_contract::setrwrdratio>;
          using setlockperiod_action = picoio::action_wrapper<"setlockperiod"_n, &system_contract::setlockperiod>;
          using setunloperiod_action = picoio::action_wrapper<"setunloperiod"_n, &system_contract::setunloperiod>;
+         using setgrdthresh_action = picoio::action_wrapper<"setgrdthresh"_n, &system_contract::setgrdthresh>;
 
          using setgiftcontra_action = picoio::action_wrapper<"setgiftcontra"_n, &system_contract::setgiftcontra>;
          using setgiftiss_action    = picoio::action_wrapper<"setgiftiss"_n,    &system_contract::setgiftiss>;
@@ -1470,18 +2102,27 @@ namespace picoiosystem {
 
          // defined in pico.system.cpp
          static picoio_global_state get_default_parameters();
+         static picoio_global_hot_state get_default_hot_parameters();
+         void mirror_hot_state();
          static picoio_global_state4 get_default_inflation_parameters();
          static picoio_global_pico_state get_default_pico_parameters();
+         static rotation_state get_default_rotation_parameters();
+         static producer_ranking_state get_default_producer_ranking();
          uint64_t get_min_threshold_stake();
          symbol core_symbol()const;
          void update_ram_supply();
 
          // defined in rex.cpp
          void runrex( uint16_t max );
+         void runrex_if_backlogged();
+         void channel_namebid_proceeds();
+         rex_backlog get_rex_backlog( uint32_t limit )const;
          void update_resource_limits( const name& from, const name& receiver, int64_t delta_net, int64_t delta_cpu );
          void check_voting_requipicoent( const name& owner,
                                         const char* error_msg = "must vote for at least 21 producers or for a proxy before buying REX" )const;
          rex_order_outcome fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex );
+         rex_order_outcome fill_rex_order( rex_pool& pool, const rex_balance_table::const_iterator& bitr, const asset& rex );
+         rex_order_outcome get_rex_order_outcome( const rex_pool& pool, const rex_balance& balance, const asset& rex )const;
          asset update_rex_account( const name& owner, const asset& proceeds, const asset& unstake_quant, bool force_vote_update = false );
          void channel_to_rex( const name& from, const asset& amount );
          void channel_namebid_to_rex( const int64_t highest_bid );
@@ -1510,27 +2151,44 @@ namespace picoiosystem {
          void picoove_loan_from_rex_pool( const rex_loan& loan );
          template <typename Index, typename Iterator>
          int64_t update_renewed_loan( Index& idx, const Iterator& itr, int64_t rented_tokens );
-         int64_t get_bancor_output( int64_t inp_reserve, int64_t out_reserve, int64_t inp );
+         void add_loan_to_bucket( rex_loan_bucket_table& buckets, uint64_t loan_num, const time_point& expiration );
 
          // defined in delegate_bandwidth.cpp
          void changebw( name from, const name& receiver,
                         const asset& stake_quantity, bool transfer );
          double stake2vote( int64_t staked, time_point locked_stake_period ) const;
          void update_voting_power( const name& voter, const asset& total_update );
+         voter_stakes_table::const_iterator get_voter_stake( const name& voter );
 
          // defined in voting.cpp
-         picoio::block_signing_authority convert_to_block_signing_authority( const picoio::public_key& producer_key );
+         static picoio::block_signing_authority convert_to_block_signing_authority( const picoio::public_key& producer_key );
          void register_producer( const name& producer, const picoio::block_signing_authority& producer_authority, const std::string& url, uint16_t location );
          void update_elected_producers( const block_timestamp& timestamp );
          void update_votes( const name& voter, const name& proxy, const std::vector<name>& producers, bool voting );
-         void propagate_weight_change( const voter_info& voter );
+         void propagate_weight_change( const voter_info& voter, producer_vote_deltas& deltas );
+         void apply_producer_vote_deltas( const producer_vote_deltas& deltas, bool voting );
+         checksum256 get_schedule_inputs_digest() const;
+         bool is_active_schedule( const std::vector<picoio::producer_authority>& producers ) const;
+         void invalidate_schedule_digest();
 
          // defined in producer_pay.cpp
          int64_t share_pervote_reward_between_producers(int64_t amount);
          void update_pervote_shares();
          void update_standby();
+         void update_pervote_slots();
+         void init_round_ledger();
+         void update_round_ledger( const std::vector<name>& active_producers, const block_timestamp& timestamp );
+         producer_counters_table::const_iterator get_producer_counters( const name& producer );
+         time_point get_last_block_time( const name& producer ) const;
 
          int64_t share_perstake_reward_between_guardians(int64_t amount);
+         int64_t update_guardian_stake( const voter_stake& stake );
+         void remove_lapsed_guardians( uint16_t max );
+         void rescan_guardian_stakes( uint16_t max );
+         uint128_t get_perstake_reward_per_share();
+         bool voter_stakes_migrated()const;
+         int64_t share_perstake_reward_by_scan(int64_t amount);
+         void settle_perstake_reward( guardian_info& guardian );
 
          void claim_perstake( const name& voter );
          void claim_pervote( const name& prod );
@@ -1544,6 +2202,8 @@ namespace picoiosystem {
 
          //defined in rotation.cpp
          std::vector<picoio::producer_authority> get_rotated_schedule();
+         void update_producer_ranking( const producer_info& prod );
+         const producer_ranking_state& get_producer_ranking();
 
          template <auto system_contract::*...Ptrs>
          class registration {
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <picoio/check.hpp>
+#include <picoio/name.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace picoiosystem {
+
+   /**
+    * Vote weight change of a single producer collected from one vote or stake change
+    */
+   struct producer_vote_delta {
+      picoio::name   producer;
+      double         weight;
+      bool           from_new_set; ///< producer is voted for by the new vote, so it has to be registered and active
+      bool           required;     ///< producer is voted for by a voter whose weight changed, so it has to be registered
+      bool           direct;       ///< delta comes from the vote itself rather than from a proxied weight change
+   };
+
+   /**
+    * Producer vote weight deltas collected from one vote or stake change, sorted by producer name.
+    *
+    * @details Deltas come from at most two sorted producer lists of at most `max_producer_votes` names each
+    * (the old and the new vote of a voter or of its proxies), so they are merged into a fixed-capacity array
+    * without heap allocation. Entries are only written when they are added, so the array is not initialized.
+    */
+   class producer_vote_deltas {
+      public:
+         static constexpr size_t max_producer_votes = 30;
+         static constexpr size_t capacity = 2 * max_producer_votes;
+
+         // `producers` have to be sorted and unique
+         void add( const std::vector<picoio::name>& producers, double weight, bool from_new_set, bool required );
+
+         const producer_vote_delta* begin()const { return _deltas.data(); }
+         const producer_vote_delta* end()const   { return _deltas.data() + _size; }
+         bool empty()const                       { return _size == 0; }
+
+      private:
+         std::array<producer_vote_delta, capacity> _deltas;
+         size_t                                    _size = 0;
+   };
+
+   inline void producer_vote_deltas::add( const std::vector<picoio::name>& producers, double weight, bool from_new_set, bool required ) {
+      size_t new_entries = 0;
+      for ( size_t i = 0, j = 0; j < producers.size(); ++j ) {
+         while ( i < _size && _deltas[i].producer < producers[j] ) {
+            ++i;
+         }
+         if ( i < _size && _deltas[i].producer == producers[j] ) {
+            ++i;
+         } else {
+            ++new_entries;
+         }
+      }
+      picoio::check( _size + new_entries <= capacity, "too many producer vote deltas" );
+
+      // both sequences are sorted, so they are merged in place starting from the back
+      size_t out = _size + new_entries;
+      size_t i = _size;
+      for ( size_t j = producers.size(); j > 0; ) {
+         if ( i > 0 && producers[j - 1] < _deltas[i - 1].producer ) {
+            _deltas[--out] = _deltas[--i];
+         } else if ( i > 0 && _deltas[i - 1].producer == producers[j - 1] ) {
+            auto& d = _deltas[--out] = _deltas[--i];
+            d.weight       += weight;
+            d.from_new_set |= from_new_set;
+            d.required     |= required;
+            d.direct       |= !required;
+            --j;
+         } else {
+            --j;
+            _deltas[--out] = producer_vote_delta{ producers[j], weight, from_new_set, required, !required };
+         }
+      }
+      _size += new_entries;
+   }
+
+} /// namespace picoiosystem
@@ -4,6 +4,9 @@
 #include <picoio/picoio.hpp>
 #include <picoio/name.hpp>
 
+#include <utility>
+#include <vector>
+
 using picoio::action_wrapper;
 using picoio::asset;
 using picoio::name;
@@ -22,11 +25,23 @@ class [[picoio::contract("rex.results")]] rex_results : picoio::contract {
       [[picoio::action]]
       void orderresult( const name& owner, const asset& proceeds );
 
+      [[picoio::action]]
+      void ordersresult( const std::vector<std::pair<name, asset>>& orders );
+
       [[picoio::action]]
       void rentresult( const asset& rented_tokens );
 
+      [[picoio::action]]
+      void rentquote( const asset& rented_tokens );
+
+      [[picoio::action]]
+      void sellquote( const asset& proceeds, const asset& stake_change, bool queued );
+
       using buyresult_action   = action_wrapper<"buyresult"_n,   &rex_results::buyresult>;
       using sellresult_action  = action_wrapper<"sellresult"_n,  &rex_results::sellresult>;
       using orderresult_action = action_wrapper<"orderresult"_n, &rex_results::orderresult>;
+      using ordersresult_action = action_wrapper<"ordersresult"_n, &rex_results::ordersresult>;
       using rentresult_action  = action_wrapper<"rentresult"_n,  &rex_results::rentresult>;
+      using rentquote_action   = action_wrapper<"rentquote"_n,   &rex_results::rentquote>;
+      using sellquote_action   = action_wrapper<"sellquote"_n,   &rex_results::sellquote>;
 };
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <picoio/check.hpp>
+
+#include <cstdint>
+#include <limits>
+
+namespace picoiosystem {
+
+   /**
+    * Scale an amount by a ratio of two pool totals.
+    *
+    * @details Computes `amount * numerator / denominator` in 128-bit integer arithmetic, rounding down.
+    *
+    * @param amount - non-negative amount to be scaled,
+    * @param numerator - non-negative pool total the result is measured in,
+    * @param denominator - positive pool total the amount is measured in.
+    */
+   inline int64_t scale_pool_amount( int64_t amount, int64_t numerator, int64_t denominator ) {
+      picoio::check( 0 <= amount && 0 <= numerator && 0 < denominator, "invalid pool amount" );
+      const uint128_t scaled = uint128_t(amount) * uint64_t(numerator) / uint64_t(denominator);
+      picoio::check( scaled <= uint128_t(std::numeric_limits<int64_t>::max()), "pool amount overflow" );
+      return int64_t(scaled);
+   }
+
+   /**
+    * Get core token value of REX.
+    *
+    * @param rex - amount of REX,
+    * @param total_lendable - total core tokens in REX pool,
+    * @param total_rex - total REX in REX pool.
+    */
+   inline int64_t rex_to_core( int64_t rex, int64_t total_lendable, int64_t total_rex ) {
+      return scale_pool_amount( rex, total_lendable, total_rex );
+   }
+
+   /**
+    * Get amount of REX worth given core tokens.
+    *
+    * @param core - amount of core tokens,
+    * @param total_lendable - total core tokens in REX pool,
+    * @param total_rex - total REX in REX pool.
+    */
+   inline int64_t core_to_rex( int64_t core, int64_t total_lendable, int64_t total_rex ) {
+      return scale_pool_amount( core, total_rex, total_lendable );
+   }
+
+   /**
+    * Get Bancor conversion output.
+    *
+    * @details Output is `inp * out_reserve / (inp_reserve + inp)` rounded down, with no floating point involved.
+    * Conversions that cannot produce a positive output return zero.
+    *
+    * @param inp_reserve - input reserve balance,
+    * @param out_reserve - output reserve balance,
+    * @param inp - amount being converted.
+    */
+   inline int64_t get_bancor_output( int64_t inp_reserve, int64_t out_reserve, int64_t inp ) {
+      if ( inp <= 0 || out_reserve <= 0 || inp_reserve < 0 ) {
+         return 0;
+      }
+      return int64_t( uint128_t(inp) * uint64_t(out_reserve) / ( uint128_t(inp_reserve) + uint64_t(inp) ) );
+   }
+
+} /// namespace picoiosystem
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <picoio/check.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace picoiosystem {
+
+   /**
+    * `2^(k/52)` for every week `k` of a year in 32.32 fixed point, vote weight doubles every 52 weeks.
+    */
+   static constexpr std::array<uint64_t, 52> vote_weight_week_multipliers = {
+      4294967296u, 4352601422u, 4411008940u, 4470200228u,
+      4530185803u, 4590976325u, 4652582593u, 4715015556u,
+      4778286306u, 4842406085u, 4907386287u, 4973238458u,
+      5039974299u, 5107605667u, 5176144580u, 5245603216u,
+      5315993917u, 5387329190u, 5459621710u, 5532884323u,
+      5607130046u, 5682372072u, 5758623770u, 5835898689u,
+      5914210559u, 5993573296u, 6074001000u, 6155507963u,
+      6238108667u, 6321817789u, 6406650203u, 6492620983u,
+      6579745403u, 6668038946u, 6757517298u, 6848196360u,
+      6940092243u, 7033221277u, 7127600007u, 7223245206u,
+      7320173866u, 7418403211u, 7517950695u, 7618834005u,
+      7721071068u, 7824680049u, 7929679357u, 8036087651u,
+      8143923836u, 8253207075u, 8363956783u, 8476192642u,
+   };
+
+   static constexpr uint32_t vote_weight_fraction_bits = 32;
+
+   /**
+    * Get vote weight of a stake.
+    *
+    * @details Vote weight is `staked * (1 - 7 * weeks_to_mature / lock_period_days) * 2^(weeks_since_epoch / 52)`.
+    * The epoch multiplier is taken from a fixed-point table and the maturity is applied with integer arithmetic,
+    * so only the final scaling by a power of two is done in floating point.
+    *
+    * @param staked - amount of staked tokens,
+    * @param weeks_to_mature - whole weeks left until the stake is unlocked,
+    * @param lock_period_days - stake lock period in days,
+    * @param weeks_since_epoch - whole weeks passed since block timestamp epoch.
+    */
+   inline double get_vote_weight( int64_t staked, int64_t weeks_to_mature, int64_t lock_period_days, int64_t weeks_since_epoch ) {
+      picoio::check( lock_period_days > 0, "stake lock period must be positive" );
+      const int64_t matured_days = lock_period_days - 7 * weeks_to_mature;
+      picoio::check( staked >= 0 && matured_days >= 0, "vote weight cannot be negative" );
+
+      const uint128_t weighted_stake = uint128_t(staked) * vote_weight_week_multipliers[weeks_since_epoch % 52]
+                                     * uint64_t(matured_days) / uint64_t(lock_period_days);
+      return std::ldexp( double(weighted_stake), int(weeks_since_epoch / 52) - int(vote_weight_fraction_bits) );
+   }
+
+} /// namespace picoiosystem
@@ -67,11 +67,11 @@ namespace picoiosystem {
       }
 
       int64_t discount = 0;
-      if ( picoio::attribute::has_attribute( _gpicostate.gifter_attr_contract, _gpicostate.gifter_attr_issuer, source_stake_from, _gpicostate.gifter_attr_name ) ) {
-         discount = picoio::attribute::get_attribute<int64_t>(_gpicostate.gifter_attr_contract, _gpicostate.gifter_attr_issuer, source_stake_from, _gpicostate.gifter_attr_name);
+      if ( picoio::attribute::has_attribute( _gpicostate->gifter_attr_contract, _gpicostate->gifter_attr_issuer, source_stake_from, _gpicostate->gifter_attr_name ) ) {
+         discount = picoio::attribute::get_attribute<int64_t>(_gpicostate->gifter_attr_contract, _gpicostate->gifter_attr_issuer, source_stake_from, _gpicostate->gifter_attr_name);
          check( (discount >= 0) && (discount <= 100'0000), "discount value should be in range[0, 100'0000]" );
       }
-      const int64_t delta2min_account_stake = ( _gstate.min_account_stake - min_threshold_stake ) * ( 1 - (discount / 100'0000.0) );
+      const int64_t delta2min_account_stake = ( _gstate->min_account_stake - min_threshold_stake ) * ( 1 - (discount / 100'0000.0) );
 
       // update stake delegated from "from" to "receiver"
       {
@@ -119,7 +119,7 @@ namespace picoiosystem {
                      tot.own_stake_amount += stake_delta.amount;
 
                      // we have to decrease free bytes in case of own stake
-                     const int64_t new_free_stake_amount = std::min( static_cast< int64_t >(_gstate.min_account_stake) - tot.own_stake_amount, tot.free_stake_amount + delta2min_account_stake);
+                     const int64_t new_free_stake_amount = std::min( static_cast< int64_t >(_gstate->min_account_stake) - tot.own_stake_amount, tot.free_stake_amount + delta2min_account_stake);
                      tot.free_stake_amount = std::max(new_free_stake_amount, 0LL);
                   }
                });
@@ -145,7 +145,7 @@ namespace picoiosystem {
                get_resource_limits( receiver, ram_bytes, net, cpu );
 
                const auto system_token_max_supply = picoio::token::get_max_supply(token_account, system_contract::get_core_symbol().code() );               
-               const double bytes_per_token = (double)_gstate.max_ram_size / (double)system_token_max_supply.amount;
+               const double bytes_per_token = (double)_gstate->max_ram_size / (double)system_token_max_supply.amount;
                const int64_t staked = tot_itr->own_stake_amount + tot_itr->free_stake_amount;
                const int64_t bytes_for_stake = bytes_per_token * staked + ram_gift_bytes( staked );
 
@@ -164,21 +164,57 @@ namespace picoiosystem {
 
    void system_contract::update_voting_power( const name& voter, const asset& total_update )
    {
-      auto voter_itr = _voters.find( voter.value );
-      if( voter_itr == _voters.end() ) {
-         voter_itr = _voters.emplace( voter, [&]( auto& v ) {
+      voter_stakes_table::const_iterator stake_itr;
+      if( _voters.find( voter.value ) == _voters.end() ) {
+         _voters.emplace( voter, [&]( auto& v ) {
             v.owner  = voter;
-            v.staked = total_update.amount;
-            v.locked_stake = total_update.amount;
+         });
+         stake_itr = _voter_stakes.emplace( voter, [&]( auto& s ) {
+            s.owner        = voter;
+            s.staked       = total_update.amount;
+            s.locked_stake = total_update.amount;
          });
       } else {
-         _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
-            v.staked += total_update.amount;
-            v.locked_stake += total_update.amount;
+         stake_itr = get_voter_stake( voter );
+         _voter_stakes.modify( stake_itr, same_payer, [&]( auto& s ) {
+            s.staked       += total_update.amount;
+            s.locked_stake += total_update.amount;
          });
       }
 
-      check( 0 <= voter_itr->staked, "stake for voting cannot be negative" );
+      check( 0 <= stake_itr->staked, "stake for voting cannot be negative" );
+      update_guardian_stake( *stake_itr );
+   }
+
+   voter_stakes_table::const_iterator system_contract::get_voter_stake( const name& voter )
+   {
+      auto stake_itr = _voter_stakes.find( voter.value );
+      if( stake_itr != _voter_stakes.end() ) {
+         return stake_itr;
+      }
+
+      // voters that were not migrated yet start from the fields left in the voters table
+      const auto& legacy = _voters.get( voter.value, "user has no resources" );
+      stake_itr = _voter_stakes.emplace( get_self(), [&]( auto& s ) {
+         s.owner                 = legacy.owner;
+         s.staked                = legacy.staked;
+         s.locked_stake          = legacy.locked_stake;
+         s.stake_lock_time       = legacy.stake_lock_time;
+         s.last_reassertion_time = legacy.last_reassertion_time;
+         s.last_claim_time       = legacy.last_claim_time;
+      });
+
+      // legacy fields are cleared, so the voters `bystake` index does not keep ordering by frozen stakes
+      _voters.modify( legacy, same_payer, [&]( auto& v ) {
+         v.staked                = 0;
+         v.locked_stake          = 0;
+         v.stake_lock_time       = time_point();
+         v.last_reassertion_time = time_point();
+         v.last_claim_time       = time_point();
+      });
+      // the stake leaves the legacy per-stake reward scan, so a guardian is registered in its guardian row
+      update_guardian_stake( *stake_itr );
+      return stake_itr;
    }
 
    void system_contract::delegatebw( const name& from, const name& receiver,
@@ -192,15 +228,14 @@ namespace picoiosystem {
 
       const auto ct = current_time_point();
       // apply stake-lock to those who received stake
-      const auto& voter = _voters.get( transfer ? receiver.value : from.value, "user has no resources");
-      _voters.modify( voter, same_payer, [&]( auto& v ) {
-         const auto restake_rate = double(stake_quantity.amount) / v.staked;
+      _voter_stakes.modify( get_voter_stake( transfer ? receiver : from ), same_payer, [&]( auto& s ) {
+         const auto restake_rate = double(stake_quantity.amount) / s.staked;
          const auto prevstake_rate = 1.0 - restake_rate;
-         const auto time_to_stake_unlock = std::max( v.stake_lock_time - ct, microseconds{} );
+         const auto time_to_stake_unlock = std::max( s.stake_lock_time - ct, microseconds{} );
 
-         v.stake_lock_time = ct
+         s.stake_lock_time = ct
                + microseconds{ static_cast< int64_t >( prevstake_rate * time_to_stake_unlock.count() ) }
-               + microseconds{ static_cast< int64_t >( restake_rate * _gpicostate.stake_lock_period.count() ) };
+               + microseconds{ static_cast< int64_t >( restake_rate * _gpicostate->stake_lock_period.count() ) };
       });
 
       // transfer staked tokens to stake_account (pico.stake)
@@ -216,13 +251,13 @@ namespace picoiosystem {
    {
       asset zero_asset( 0, core_symbol() );
       check( unstake_quantity >= zero_asset, "must unstake a positive amount" );
-      check( _gstate.total_activated_stake >= min_activated_stake,
+      check( _ghotstate->total_activated_stake >= min_activated_stake,
              "cannot undelegate bandwidth until the chain is activated (at least 15% of all tokens participate in voting)" );
 
 
       const auto ct = current_time_point();
-      const auto& voter = _voters.get(from.value, "user has no resources");
-      check(voter.stake_lock_time <= ct, "cannot undelegate during stake lock period");
+      const auto stake_itr = get_voter_stake( from );
+      check(stake_itr->stake_lock_time <= ct, "cannot undelegate during stake lock period");
 
       // for picoio.stake both transfer and refund make no sense
       if ( stake_account != from ) {
@@ -245,7 +280,7 @@ namespace picoiosystem {
 
                r.unlock_time = ct
                      + microseconds{ static_cast< int64_t >( prevstake_rate * time_to_stake_unlock.count() ) }
-                     + microseconds{ static_cast< int64_t >( restake_rate * _gpicostate.stake_lock_period.count() ) };
+                     + microseconds{ static_cast< int64_t >( restake_rate * _gpicostate->stake_lock_period.count() ) };
             });
 
             check( 0 <= req->resource_amount.amount, "negative net refund amount" ); //should never happen
@@ -255,7 +290,7 @@ namespace picoiosystem {
                r.resource_amount    = unstake_quantity;
                r.request_time       = current_time_point();
                r.last_claim_time    = current_time_point();
-               r.unlock_time        = current_time_point() + _gpicostate.stake_unlock_period;
+               r.unlock_time        = current_time_point() + _gpicostate->stake_unlock_period;
             });
          } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
       }
@@ -319,7 +354,7 @@ namespace picoiosystem {
 
    int64_t system_contract::ram_gift_bytes( int64_t stake ) const {
       const auto system_token_max_supply = picoio::token::get_max_supply(token_account, system_contract::get_core_symbol().code() );
-      const double bytes_per_token = (double)_gstate.max_ram_size / (double)system_token_max_supply.amount;
+      const double bytes_per_token = (double)_gstate->max_ram_size / (double)system_token_max_supply.amount;
 
       return std::max( int64_t{0}, min_account_ram - static_cast< int64_t >(stake * bytes_per_token) );
    }
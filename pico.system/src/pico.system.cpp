@@ -21,31 +21,30 @@ namespace picoiosystem {
    system_contract::system_contract( name s, name code, datastream<const char*> ds )
    :native(s,code,ds),
     _voters(get_self(), get_self().value),
+    _voter_stakes(get_self(), get_self().value),
+    _guardians(get_self(), get_self().value),
     _producers(get_self(), get_self().value),
     _producers2(get_self(), get_self().value),
-    _global(get_self(), get_self().value),
-    _global2(get_self(), get_self().value),
-    _global3(get_self(), get_self().value),
-    _global4(get_self(), get_self().value),
-    _globalpico(get_self(), get_self().value),
-    _rotation(get_self(), get_self().value),
+    _producer_counters(get_self(), get_self().value),
+    _gstate(get_self(), get_self().value, &system_contract::get_default_parameters),
+    _ghotstate(get_self(), get_self().value, &system_contract::get_default_hot_parameters),
+    _gstate2(get_self(), get_self().value, []{ return picoio_global_state2{}; }),
+    _gstate3(get_self(), get_self().value, []{ return picoio_global_state3{}; }),
+    _gstate4(get_self(), get_self().value, &system_contract::get_default_inflation_parameters),
+    _gpicostate(get_self(), get_self().value, &system_contract::get_default_pico_parameters),
     _rexpool(get_self(), get_self().value),
     _rexfunds(get_self(), get_self().value),
     _rexbalance(get_self(), get_self().value),
-    _rexorders(get_self(), get_self().value)
+    _rexorders(get_self(), get_self().value),
+    _grotation(get_self(), get_self().value, &system_contract::get_default_rotation_parameters),
+    _gpervotepay(get_self(), get_self().value, []{ return pervote_reward_state{}; }),
+    _groundledger(get_self(), get_self().value, []{ return round_ledger_state{}; }),
+    _gscheddigest(get_self(), get_self().value, []{ return schedule_digest_state{}; }),
+    _gprodranking(get_self(), get_self().value, &system_contract::get_default_producer_ranking),
+    _grexmaint(get_self(), get_self().value, []{ return rex_maintenance_state{}; }),
+    _ggrdrescan(get_self(), get_self().value, []{ return guardian_rescan_state{}; })
    {
       //print( "construct system\n" );
-      _gstate  = _global.exists() ? _global.get() : get_default_parameters();
-      _gstate2 = _global2.exists() ? _global2.get() : picoio_global_state2{};
-      _gstate3 = _global3.exists() ? _global3.get() : picoio_global_state3{};
-      _gstate4 = _global4.exists() ? _global4.get() : get_default_inflation_parameters();
-      _gpicostate = _globalpico.exists() ? _globalpico.get() : get_default_pico_parameters();
-
-      _grotation = _rotation.get_or_create(_self, rotation_state{
-         .last_rotation_time      = time_point{},
-         .rotation_period         = picoio::hours(4),
-         .standby_prods_to_rotate = 4
-      });
    }
 
    picoio_global_state system_contract::get_default_parameters() {
@@ -54,6 +53,48 @@ namespace picoiosystem {
       return dp;
    }
 
+   picoio_global_hot_state system_contract::get_default_hot_parameters() {
+      // counters are copied from their legacy location in global state on the first access after upgrade
+      global_state_singleton global( picoio::current_receiver(), picoio::current_receiver().value );
+      if ( !global.exists() ) {
+         return picoio_global_hot_state{};
+      }
+
+      const auto gstate = global.get();
+      picoio_global_hot_state hot;
+      hot.last_schedule_version             = gstate.last_schedule_version;
+      hot.current_round_start_time          = gstate.current_round_start_time;
+      hot.last_producer_schedule_update     = gstate.last_producer_schedule_update;
+      hot.last_pervote_bucket_fill          = gstate.last_pervote_bucket_fill;
+      hot.perstake_bucket                   = gstate.perstake_bucket;
+      hot.pervote_bucket                    = gstate.pervote_bucket;
+      hot.perblock_bucket                   = gstate.perblock_bucket;
+      hot.total_unpaid_blocks               = gstate.total_unpaid_blocks;
+      hot.total_guardians_stake             = gstate.total_guardians_stake;
+      hot.total_activated_stake             = gstate.total_activated_stake;
+      hot.total_producer_vote_weight        = gstate.total_producer_vote_weight;
+      hot.total_active_producer_vote_weight = gstate.total_active_producer_vote_weight;
+      return hot;
+   }
+
+   void system_contract::mirror_hot_state() {
+      // legacy counters in global state are refreshed only when the record is written anyway
+      const auto& hot = _ghotstate.get();
+      auto& gstate = _gstate.modify();
+      gstate.last_schedule_version             = hot.last_schedule_version;
+      gstate.current_round_start_time          = hot.current_round_start_time;
+      gstate.last_producer_schedule_update     = hot.last_producer_schedule_update;
+      gstate.last_pervote_bucket_fill          = hot.last_pervote_bucket_fill;
+      gstate.perstake_bucket                   = hot.perstake_bucket;
+      gstate.pervote_bucket                    = hot.pervote_bucket;
+      gstate.perblock_bucket                   = hot.perblock_bucket;
+      gstate.total_unpaid_blocks               = hot.total_unpaid_blocks;
+      gstate.total_guardians_stake             = hot.total_guardians_stake;
+      gstate.total_activated_stake             = hot.total_activated_stake;
+      gstate.total_producer_vote_weight        = hot.total_producer_vote_weight;
+      gstate.total_active_producer_vote_weight = hot.total_active_producer_vote_weight;
+   }
+
    picoio_global_state4 system_contract::get_default_inflation_parameters() {
       picoio_global_state4 gs4;
       gs4.continuous_rate      = get_continuous_rate(default_annual_rate);
@@ -84,18 +125,52 @@ namespace picoiosystem {
       return pico_state;
    }
 
+   rotation_state system_contract::get_default_rotation_parameters() {
+      return rotation_state{
+         .last_rotation_time      = time_point{},
+         .rotation_period         = picoio::hours(4),
+         .standby_prods_to_rotate = 4
+      };
+   }
+
+   producer_ranking_state system_contract::get_default_producer_ranking() {
+      // ranking is built from the votes index on the first access after upgrade and whenever it runs short
+      producers_table producers( picoio::current_receiver(), picoio::current_receiver().value );
+      auto sorted_prods = producers.get_index<"prototalvote"_n>();
+
+      producer_ranking_state ranking;
+      for ( auto prod_it = sorted_prods.begin(); prod_it != sorted_prods.end() && prod_it->active() && 0 < prod_it->total_votes; ++prod_it ) {
+         if ( ranking.producers.size() == producer_ranking_state::max_ranked_producers ) {
+            ranking.truncated = true;
+            break;
+         }
+         ranking.producers.push_back( ranked_producer{ .owner = prod_it->owner, .total_votes = prod_it->total_votes } );
+      }
+      return ranking;
+   }
+
    symbol system_contract::core_symbol()const {
       const static auto sym = get_core_symbol();
       return sym;
    }
 
    system_contract::~system_contract() {
-      _global.set( _gstate, get_self() );
-      _global2.set( _gstate2, get_self() );
-      _global3.set( _gstate3, get_self() );
-      _global4.set( _gstate4, get_self() );
-      _globalpico.set( _gpicostate, get_self() );
-      _rotation.set( _grotation, get_self() );
+      if ( _gstate.dirty() ) {
+         mirror_hot_state();
+      }
+      _gstate.save( get_self() );
+      _ghotstate.save( get_self() );
+      _gstate2.save( get_self() );
+      _gstate3.save( get_self() );
+      _gstate4.save( get_self() );
+      _gpicostate.save( get_self() );
+      _grotation.save( get_self() );
+      _gpervotepay.save( get_self() );
+      _groundledger.save( get_self() );
+      _gscheddigest.save( get_self() );
+      _gprodranking.save( get_self() );
+      _grexmaint.save( get_self() );
+      _ggrdrescan.save( get_self() );
    }
 
    void system_contract::setrwrdratio( double stake_share, double vote_share ) {
@@ -104,66 +179,95 @@ namespace picoiosystem {
       check(stake_share > 0, "share must be positive");
       check(vote_share > 0, "share must be positive");
       check(stake_share + vote_share < 1.0, "perstake and pervote shares together must be less than 1.0");
-      _gpicostate.per_stake_share = stake_share;
-      _gpicostate.per_vote_share = vote_share;
+      auto& gpicostate = _gpicostate.modify();
+      gpicostate.per_stake_share = stake_share;
+      gpicostate.per_vote_share = vote_share;
    }
 
    void system_contract::setinacttime( uint64_t period_in_minutes ) {
    require_auth(get_self());
 
    check(period_in_minutes != 0, "block producer maximum inactivity time cannot be zero");
-   _gpicostate.producer_max_inactivity_time = picoio::minutes(period_in_minutes);
+   _gpicostate.modify().producer_max_inactivity_time = picoio::minutes(period_in_minutes);
     }
 
     void system_contract::setpnshperiod( uint64_t period_in_days ) {
        require_auth(get_self());
 
        check(period_in_days != 0, "punishment period cannot be zero");
-       _gpicostate.producer_inactivity_punishment_period = picoio::days(period_in_days);
+       _gpicostate.modify().producer_inactivity_punishment_period = picoio::days(period_in_days);
     }
 
    void system_contract::setlockperiod( uint64_t period_in_days ) {
       require_auth(get_self());
 
       check(period_in_days != 0, "lock period cannot be zero");
-      _gpicostate.stake_lock_period = picoio::days(period_in_days);
+      _gpicostate.modify().stake_lock_period = picoio::days(period_in_days);
    }
 
    void system_contract::setunloperiod( uint64_t period_in_days ) {
       require_auth(get_self());
 
       check(period_in_days != 0, "unlock period cannot be zero");
-      _gpicostate.stake_unlock_period = picoio::days(period_in_days);
+      _gpicostate.modify().stake_unlock_period = picoio::days(period_in_days);
+   }
+
+   void system_contract::setgrdthresh( int64_t threshold ) {
+      require_auth(get_self());
+
+      check(threshold > 0, "guardian stake threshold must be positive");
+      const auto lower = std::min( threshold, _gpicostate->guardian_stake_threshold );
+      const auto upper = std::max( threshold, _gpicostate->guardian_stake_threshold );
+      _gpicostate.modify().guardian_stake_threshold = threshold;
+
+      // only voters with stake between the old and the new threshold change their guardian status,
+      // they are updated in bounded batches, a pending rescan restarts over both ranges
+      auto& rescan = _ggrdrescan.modify();
+      if ( rescan.lower < rescan.upper ) {
+         rescan.lower = std::min( rescan.lower, lower );
+         rescan.upper = std::max( rescan.upper, upper );
+      } else {
+         rescan.lower = lower;
+         rescan.upper = upper;
+      }
+      rescan.cursor = name{};
+   }
+
+   void system_contract::updguardians( uint16_t max ) {
+      require_auth(get_self());
+
+      check( _ggrdrescan->lower < _ggrdrescan->upper, "no guardian rescan is pending" );
+      rescan_guardian_stakes( max );
    }
 
    void system_contract::setgiftcontra( name value ) {
       require_auth(get_self());
 
-      _gpicostate.gifter_attr_contract = value;
+      _gpicostate.modify().gifter_attr_contract = value;
    }
 
    void system_contract::setgiftiss( name value ) {
       require_auth(get_self());
 
-      _gpicostate.gifter_attr_issuer = value;
+      _gpicostate.modify().gifter_attr_issuer = value;
    }
 
    void system_contract::setgiftattr( name value ) {
       require_auth(get_self());
 
-      _gpicostate.gifter_attr_name = value;
+      _gpicostate.modify().gifter_attr_name = value;
    }
 
    void system_contract::setminstake( uint64_t min_account_stake ) {
       require_auth( get_self() );
 
-      _gstate.min_account_stake = min_account_stake;
+      _gstate.modify().min_account_stake = min_account_stake;
    }
 
    void system_contract::setactvstake() {
       require_auth( get_self() );
 
-      _gstate.total_activated_stake = min_activated_stake;
+      _ghotstate.modify().total_activated_stake = min_activated_stake;
    }
 
    uint64_t system_contract::get_min_threshold_stake() {
@@ -174,42 +278,42 @@ namespace picoiosystem {
       uint64_t oracle_min_account_stake = account_usd_price / pico_usd_it->price;
 
       if ( is_valid_price && oracle_min_account_stake > 0 ) {
-         return std::min(oracle_min_account_stake, _gstate.min_account_stake);
+         return std::min(oracle_min_account_stake, _gstate->min_account_stake);
       }
-      return _gstate.min_account_stake;
+      return _gstate->min_account_stake;
    }
 
    void system_contract::setram( uint64_t max_ram_size ) {
       require_auth( get_self() );
 
-      check( _gstate.max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
+      check( _gstate->max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
       check( max_ram_size < 1024ll*1024*1024*1024*1024, "ram size is unrealistic" );
-      check( max_ram_size > _gstate.total_ram_bytes_reserved, "attempt to set max below reserved" );
+      check( max_ram_size > _gstate->total_ram_bytes_reserved, "attempt to set max below reserved" );
 
-      _gstate.max_ram_size = max_ram_size;
+      _gstate.modify().max_ram_size = max_ram_size;
    }
 
    void system_contract::update_ram_supply() {
       auto cbt = picoio::current_block_time();
 
-      if( cbt <= _gstate2.last_ram_increase ) return;
+      if( cbt <= _gstate2->last_ram_increase ) return;
 
-      auto new_ram = (cbt.slot - _gstate2.last_ram_increase.slot)*_gstate2.new_ram_per_block;
-      _gstate.max_ram_size += new_ram;
-      _gstate2.last_ram_increase = cbt;
+      auto new_ram = (cbt.slot - _gstate2->last_ram_increase.slot)*_gstate2->new_ram_per_block;
+      _gstate.modify().max_ram_size += new_ram;
+      _gstate2.modify().last_ram_increase = cbt;
    }
 
    void system_contract::setramrate( uint16_t bytes_per_block ) {
       require_auth( get_self() );
 
       update_ram_supply();
-      _gstate2.new_ram_per_block = bytes_per_block;
+      _gstate2.modify().new_ram_per_block = bytes_per_block;
    }
 
    void system_contract::setparams( const picoio::blockchain_parameters& params ) {
       require_auth( get_self() );
-      (picoio::blockchain_parameters&)(_gstate) = params;
-      check( 3 <= _gstate.max_authority_depth, "max_authority_depth should be at least 3" );
+      (picoio::blockchain_parameters&)(_gstate.modify()) = params;
+      check( 3 <= _gstate->max_authority_depth, "max_authority_depth should be at least 3" );
       set_blockchain_parameters( params );
    }
 
@@ -243,11 +347,13 @@ namespace picoiosystem {
 
    void system_contract::rmvproducer( const name& producer ) {
       require_auth( get_self() );
-      auto prod = _producers.get( producer.value, "producer not found" );
+      const auto& prod = _producers.get( producer.value, "producer not found" );
 
       _producers.modify( prod, same_payer, [&](auto& p) {
             p.deactivate();
       });
+      update_producer_ranking( prod );
+      invalidate_schedule_digest();
    }
 
    void system_contract::punishprod( const name& producer ) {
@@ -257,23 +363,32 @@ namespace picoiosystem {
     const auto ct = current_time_point();
     check( prod->active() && prod->top21_chosen_time != time_point(picoio::seconds(0)), "can only punish top21 active producers" );
 
-    check( ct - prod->last_block_time >= _gpicostate.producer_max_inactivity_time, "not enough inactivity to punish producer" );
-    check( ct - prod->top21_chosen_time >= _gpicostate.producer_max_inactivity_time, "not enough inactivity to punish producer" );
+    check( ct - get_last_block_time( producer ) >= _gpicostate->producer_max_inactivity_time, "not enough inactivity to punish producer" );
+    check( ct - prod->top21_chosen_time >= _gpicostate->producer_max_inactivity_time, "not enough inactivity to punish producer" );
 
     _producers.modify( prod, same_payer, [&](auto& p) {
-          p.punished_until = ct + _gpicostate.producer_inactivity_punishment_period;
+          p.punished_until = ct + _gpicostate->producer_inactivity_punishment_period;
           p.top21_chosen_time = time_point(picoio::seconds(0));
           p.deactivate();
        });
+    update_producer_ranking( *prod );
+    invalidate_schedule_digest();
 }
 
    void system_contract::updtrevision( uint8_t revision ) {
       require_auth( get_self() );
-      check( _gstate2.revision < 255, "can not incpicoent revision" ); // prevent wrap around
-      check( revision == _gstate2.revision + 1, "can only incpicoent revision by one" );
+      check( _gstate2->revision < 255, "can not incpicoent revision" ); // prevent wrap around
+      check( revision == _gstate2->revision + 1, "can only incpicoent revision by one" );
       check( revision <= 1, // set upper bound to greatest revision supported in the code
              "specified revision is not yet supported by the code" );
-      _gstate2.revision = revision;
+      _gstate2.modify().revision = revision;
+   }
+
+   void system_contract::migrglobal() {
+      require_auth( get_self() );
+      check( !global_hot_state_singleton( get_self(), get_self().value ).exists(), "global state is already migrated" );
+      _ghotstate.modify();
+      _gstate.modify();
    }
 
    void system_contract::setinflation( int64_t annual_rate, int64_t inflation_pay_factor, int64_t votepay_factor ) {
@@ -285,10 +400,10 @@ namespace picoiosystem {
       if ( votepay_factor < pay_factor_precision ) {
          check( false, "votepay_factor must not be less than " + std::to_string(pay_factor_precision) );
       }
-      _gstate4.continuous_rate      = get_continuous_rate(annual_rate);
-      _gstate4.inflation_pay_factor = inflation_pay_factor;
-      _gstate4.votepay_factor       = votepay_factor;
-      _global4.set( _gstate4, get_self() );
+      auto& gstate4 = _gstate4.modify();
+      gstate4.continuous_rate      = get_continuous_rate(annual_rate);
+      gstate4.inflation_pay_factor = inflation_pay_factor;
+      gstate4.votepay_factor       = votepay_factor;
    }
 
    /**
@@ -332,16 +447,16 @@ namespace picoiosystem {
       int64_t free_stake_amount = 0;
       int64_t free_gift_bytes   = 0;
 
-      if ( picoio::attribute::has_attribute( _gpicostate.gifter_attr_contract, _gpicostate.gifter_attr_issuer, creator, _gpicostate.gifter_attr_name ) ) {
-         const auto discount = picoio::attribute::get_attribute< int64_t >( _gpicostate.gifter_attr_contract, _gpicostate.gifter_attr_issuer, creator, _gpicostate.gifter_attr_name );
+      if ( picoio::attribute::has_attribute( _gpicostate->gifter_attr_contract, _gpicostate->gifter_attr_issuer, creator, _gpicostate->gifter_attr_name ) ) {
+         const auto discount = picoio::attribute::get_attribute< int64_t >( _gpicostate->gifter_attr_contract, _gpicostate->gifter_attr_issuer, creator, _gpicostate->gifter_attr_name );
          // discount attribute is set as percent with precision of 4 symbols
          // 0 - 0.0000%, 100'0000 - 100.0000%
          check( (discount >= 0) && (discount <= 100'0000), "discount value should be in range[0, 100'0000]" );
          const auto discount_rate = discount / 100'0000.0;
 
          const auto system_token_max_supply = picoio::token::get_max_supply(token_account, system_contract::get_core_symbol().code() );
-         const double bytes_per_token       = (double)_gstate.max_ram_size / (double)system_token_max_supply.amount;
-         free_stake_amount                  = discount_rate * _gstate.min_account_stake;
+         const double bytes_per_token       = (double)_gstate->max_ram_size / (double)system_token_max_supply.amount;
+         free_stake_amount                  = discount_rate * _gstate->min_account_stake;
          free_gift_bytes                    = bytes_per_token * free_stake_amount;
       }
 
@@ -374,8 +489,8 @@ namespace picoiosystem {
    void system_contract::init( unsigned_int version, const symbol& core ) {
       require_auth( get_self() );
       check( version.value == 0, "unsupported version for init action" );
-      check( _gstate.core_symbol == symbol(), "system contract has already been initialized" );
-      _gstate.core_symbol = core;
+      check( _gstate->core_symbol == symbol(), "system contract has already been initialized" );
+      _gstate.modify().core_symbol = core;
 
       auto system_token_supply   = picoio::token::get_supply(token_account, core.code() );
       check( system_token_supply.symbol == core, "specified core symbol does not exist (precision mismatch)" );
@@ -386,6 +501,6 @@ namespace picoiosystem {
    }
 
    bool system_contract::vote_is_reasserted( picoio::time_point last_reassertion_time ) const {
-         return (current_time_point() - last_reassertion_time) < _gpicostate.reassertion_period;
+         return (current_time_point() - last_reassertion_time) < _gpicostate->reassertion_period;
    }
 } /// pico.system
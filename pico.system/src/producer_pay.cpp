@@ -8,6 +8,8 @@ namespace picoiosystem {
 
    const static int producer_repetitions = 12;
    const static int blocks_per_round = system_contract::max_block_producers * producer_repetitions;
+   const static uint16_t lapsed_guardians_per_action = 10;
+   const static uint16_t rescanned_voters_per_action = 50;
 
    using picoio::current_time_point;
    using picoio::microseconds;
@@ -15,31 +17,72 @@ namespace picoiosystem {
 
    int64_t system_contract::share_pervote_reward_between_producers(int64_t amount)
    {
-      const auto reward_period_without_producing = microseconds(_grotation.rotation_period.count() * _grotation.standby_prods_to_rotate);
+      // rewards are accumulated in per-vote slots, producer rows are updated only on claim or when a producer leaves the slots
+      update_pervote_slots();
+      // shares are recomputed only once after any number of vote or schedule changes
+      if (_ghotstate->pervote_shares_changed) {
+         update_pervote_shares();
+      }
+
+      const auto reward_period_without_producing = microseconds(_grotation->rotation_period.count() * _grotation->standby_prods_to_rotate);
       const auto ct = current_time_point();
       int64_t total_reward_distributed = 0;
-      for (const auto& p: _gstate.last_schedule) {
+      size_t slot_index = 0;
+      auto share_reward = [&](const std::pair<name, double>& p) {
          const auto reward = int64_t(amount * p.second);
          total_reward_distributed += reward;
-         const auto& prod = _producers.get(p.first.value);
-         if (ct - prod.last_block_time <= reward_period_without_producing) {
-            _producers.modify(prod, picoio::same_payer, [&](auto &p) {
-               p.pending_pervote_reward += reward;
-            });
+         if (reward > 0 && ct - get_last_block_time(p.first) <= reward_period_without_producing) {
+            _gpervotepay.modify().slots[slot_index].unsettled_reward += reward;
          }
+         ++slot_index;
+      };
+      std::for_each(std::begin(_gstate->last_schedule), std::end(_gstate->last_schedule), share_reward);
+      std::for_each(std::begin(_gstate->standby), std::end(_gstate->standby), share_reward);
+
+      check(total_reward_distributed <= amount, "distributed reward above the given amount");
+      return total_reward_distributed;
+   }
+
+   void system_contract::update_pervote_slots()
+   {
+      const auto slots_count = _gstate->last_schedule.size() + _gstate->standby.size();
+      auto slot_producer = [this](size_t i) -> name {
+         return i < _gstate->last_schedule.size() ? _gstate->last_schedule[i].first
+                                                 : _gstate->standby[i - _gstate->last_schedule.size()].first;
+      };
+
+      bool is_up_to_date = _gpervotepay->slots.size() == slots_count;
+      for (size_t i = 0; is_up_to_date && i < slots_count; i++) {
+         is_up_to_date = _gpervotepay->slots[i].producer == slot_producer(i);
       }
-      for (const auto& p: _gstate.standby) {
-         const auto reward = int64_t(amount * p.second);
-         total_reward_distributed += reward;
-         const auto& prod = _producers.get(p.first.value);
-         if (ct - prod.last_block_time <= reward_period_without_producing) {
-            _producers.modify(prod, picoio::same_payer, [&](auto &p) {
-               p.pending_pervote_reward += reward;
+      if (is_up_to_date) {
+         return;
+      }
+
+      auto& gpervotepay = _gpervotepay.modify();
+      std::vector<pervote_reward_slot> slots;
+      slots.reserve(slots_count);
+      for (size_t i = 0; i < slots_count; i++) {
+         const auto producer = slot_producer(i);
+         auto prev = std::find_if(std::begin(gpervotepay.slots), std::end(gpervotepay.slots),
+                                  [&producer](const auto& element) { return element.producer == producer; });
+         if (prev != std::end(gpervotepay.slots)) {
+            slots.push_back(*prev);
+            prev->producer = name{};
+         } else {
+            slots.push_back(pervote_reward_slot{ .producer = producer });
+         }
+      }
+
+      // producers that left both schedule and standby keep their rewards in the producer counters table
+      for (const auto& slot: gpervotepay.slots) {
+         if (slot.producer && slot.unsettled_reward > 0) {
+            _producer_counters.modify(get_producer_counters(slot.producer), same_payer, [&](auto& c) {
+               c.pending_pervote_reward += slot.unsettled_reward;
             });
          }
       }
-      check(total_reward_distributed <= amount, "distributed reward above the given amount");
-      return total_reward_distributed;
+      gpervotepay.slots = std::move(slots);
    }
 
    void system_contract::update_pervote_shares()
@@ -50,61 +93,107 @@ namespace picoiosystem {
          return l + prod.total_votes;
       };
       double total_share = 0.0;
-      total_share = std::accumulate(std::begin(_gstate.last_schedule), std::end(_gstate.last_schedule),
+      total_share = std::accumulate(std::begin(_gstate->last_schedule), std::end(_gstate->last_schedule),
                                     total_share, share_accumulator);
-      total_share = std::accumulate(std::begin(_gstate.standby), std::end(_gstate.standby),
+      total_share = std::accumulate(std::begin(_gstate->standby), std::end(_gstate->standby),
                                     total_share, share_accumulator);
-      _gstate.total_active_producer_vote_weight = total_share;
+      _ghotstate.modify().total_active_producer_vote_weight = total_share;
 
       auto update_pervote_share = [this](auto& p) {
          const auto& prod_name = p.first;
          const auto& prod = _producers.get(prod_name.value);
-         const double share = prod.total_votes / _gstate.total_active_producer_vote_weight;
+         const double share = prod.total_votes / _ghotstate->total_active_producer_vote_weight;
          // need to cut precision because sum of all shares can be greater that 1 due to floating point arithmetics
          p.second = std::floor(share * 100000.0) / 100000.0;
       };
-      std::for_each(std::begin(_gstate.last_schedule), std::end(_gstate.last_schedule), update_pervote_share);
-      std::for_each(std::begin(_gstate.standby), std::end(_gstate.standby), update_pervote_share);
+      auto& gstate = _gstate.modify();
+      std::for_each(std::begin(gstate.last_schedule), std::end(gstate.last_schedule), update_pervote_share);
+      std::for_each(std::begin(gstate.standby), std::end(gstate.standby), update_pervote_share);
+      _ghotstate.modify().pervote_shares_changed = false;
    }
 
    void system_contract::update_standby()
    {
       std::vector<std::pair<name, double>> rotation;
-      std::transform(std::begin(_grotation.standby_rotation),
-                     std::end(_grotation.standby_rotation),
+      std::transform(std::begin(_grotation->standby_rotation),
+                     std::end(_grotation->standby_rotation),
                      std::back_inserter(rotation),
                      [](const auto& auth) { return std::make_pair(auth.producer_name, 0.0); });
-      _gstate.standby.clear();
-      _gstate.standby.reserve(rotation.size());
+      auto& gstate = _gstate.modify();
+      gstate.standby.clear();
+      gstate.standby.reserve(rotation.size());
       auto name_double_comparator = [](const std::pair<name, double>& l, const std::pair<name, double>& r) { return l.first < r.first; };
       std::sort(std::begin(rotation), std::end(rotation), name_double_comparator);
       std::set_difference(std::begin(rotation), std::end(rotation),
-                          std::begin(_gstate.last_schedule), std::end(_gstate.last_schedule),
-                          std::back_inserter(_gstate.standby),
+                          std::begin(gstate.last_schedule), std::end(gstate.last_schedule),
+                          std::back_inserter(gstate.standby),
                           name_double_comparator);
+      update_pervote_slots();
    }
 
    int64_t system_contract::share_perstake_reward_between_guardians(int64_t amount)
    {
-      using namespace picoio;
-      int64_t total_reward_distributed = 0;
+      // rewards are not distributed here, guardians settle their share of the accumulator lazily,
+      // total_guardians_stake is kept up to date whenever a guardian stake changes or lapses
+      remove_lapsed_guardians( lapsed_guardians_per_action );
+
+      // guardians which were not migrated yet are only known to the full scan
+      if ( !voter_stakes_migrated() ) {
+         return share_perstake_reward_by_scan( amount );
+      }
 
-      const auto sorted_voters = _voters.get_index<"bystake"_n>();
-      _gstate.total_guardians_stake = 0;
-      for (auto it = sorted_voters.rbegin(); it != sorted_voters.rend() && it->staked >= _gpicostate.guardian_stake_threshold; it++) {
+      const uint128_t reward_per_share = get_perstake_reward_per_share();
+      if ( _ghotstate->total_guardians_stake <= 0 || amount <= 0 ) {
+         return 0;
+      }
+
+      *_gpicostate.modify().perstake_reward_per_share = reward_per_share + uint128_t(amount) * reward_per_share_precision / uint64_t(_ghotstate->total_guardians_stake);
+      return amount;
+   }
+
+   bool system_contract::voter_stakes_migrated()const
+   {
+      // voters keep zero stake in the voters table once their stake is moved, see `get_voter_stake`
+      const auto legacy_voters = _voters.get_index<"bystake"_n>();
+      return legacy_voters.begin() == legacy_voters.end() || legacy_voters.rbegin()->staked <= 0;
+   }
+
+   int64_t system_contract::share_perstake_reward_by_scan(int64_t amount)
+   {
+      // stake of a voter is either left in the voters table or registered in its guardian row, never in both
+      const auto threshold = _gpicostate->guardian_stake_threshold;
+      const auto legacy_voters = _voters.get_index<"bystake"_n>();
+      int64_t total_stake = 0;
+      for (auto it = legacy_voters.rbegin(); it != legacy_voters.rend() && it->staked >= threshold; it++) {
          if ( vote_is_reasserted( it->last_reassertion_time ) ) {
-            _gstate.total_guardians_stake += it->staked;
+            total_stake += it->staked;
+         }
+      }
+      for (const auto& g: _guardians) {
+         if ( g.guardian_stake > 0 && vote_is_reasserted( g.last_reassertion_time ) ) {
+            total_stake += g.guardian_stake;
          }
       }
+      if ( total_stake <= 0 || amount <= 0 ) {
+         return 0;
+      }
 
-      for (auto it = sorted_voters.rbegin(); it != sorted_voters.rend() && it->staked >= _gpicostate.guardian_stake_threshold; it++) {
+      int64_t total_reward_distributed = 0;
+      for (auto it = legacy_voters.rbegin(); it != legacy_voters.rend() && it->staked >= threshold; it++) {
          if ( vote_is_reasserted( it->last_reassertion_time ) ) {
-            const int64_t pending_perstake_reward = amount * ( double(it->staked) / double(_gstate.total_guardians_stake) );
-
-            _voters.modify( *it, same_payer, [&](auto &v) {
+            const int64_t pending_perstake_reward = amount * ( double(it->staked) / double(total_stake) );
+            _voters.modify( *it, same_payer, [&](auto& v) {
                v.pending_perstake_reward += pending_perstake_reward;
             });
-
+            total_reward_distributed += pending_perstake_reward;
+         }
+      }
+      for (auto g = _guardians.begin(); g != _guardians.end(); ++g) {
+         if ( g->guardian_stake > 0 && vote_is_reasserted( g->last_reassertion_time ) ) {
+            const int64_t pending_perstake_reward = amount * ( double(g->guardian_stake) / double(total_stake) );
+            _guardians.modify( g, same_payer, [&](auto& r) {
+               r.pending_reward += pending_perstake_reward;
+            });
             total_reward_distributed += pending_perstake_reward;
          }
       }
@@ -113,6 +202,237 @@ namespace picoiosystem {
       return total_reward_distributed;
    }
 
+   uint128_t system_contract::get_perstake_reward_per_share()
+   {
+      if ( !_gpicostate->perstake_reward_per_share.has_value() ) {
+         // from now on total guardians stake is the sum of guardian rows, the accumulator only grows
+         // once every voter stake is migrated, see `share_perstake_reward_between_guardians`
+         _gpicostate.modify().perstake_reward_per_share.emplace( 0 );
+         _ghotstate.modify().total_guardians_stake = 0;
+      }
+      return *_gpicostate->perstake_reward_per_share;
+   }
+
+   void system_contract::settle_perstake_reward( guardian_info& guardian )
+   {
+      const uint128_t reward_per_share = get_perstake_reward_per_share();
+      guardian.pending_reward += int64_t( uint128_t(guardian.guardian_stake) * (reward_per_share - guardian.reward_per_share) / reward_per_share_precision );
+      guardian.reward_per_share = reward_per_share;
+   }
+
+   int64_t system_contract::update_guardian_stake( const voter_stake& stake )
+   {
+      const int64_t guardian_stake = stake.staked >= _gpicostate->guardian_stake_threshold && vote_is_reasserted( stake.last_reassertion_time )
+                                   ? stake.staked
+                                   : 0;
+
+      auto guardian = _guardians.find( stake.owner.value );
+      if ( guardian == _guardians.end() ) {
+         if ( guardian_stake > 0 ) {
+            _guardians.emplace( get_self(), [&]( auto& g ) {
+               g.owner                 = stake.owner;
+               g.guardian_stake        = guardian_stake;
+               g.reward_per_share      = get_perstake_reward_per_share();
+               g.last_reassertion_time = stake.last_reassertion_time;
+            });
+            _ghotstate.modify().total_guardians_stake += guardian_stake;
+         }
+      } else if ( guardian->guardian_stake != guardian_stake || guardian->last_reassertion_time != stake.last_reassertion_time ) {
+         _ghotstate.modify().total_guardians_stake += guardian_stake - guardian->guardian_stake;
+         _guardians.modify( guardian, same_payer, [&]( auto& g ) {
+            settle_perstake_reward( g );
+            g.guardian_stake        = guardian_stake;
+            g.last_reassertion_time = stake.last_reassertion_time;
+         });
+         if ( guardian->guardian_stake == 0 && guardian->pending_reward == 0 ) {
+            _guardians.erase( guardian );
+         }
+      }
+
+      return guardian_stake;
+   }
+
+   void system_contract::remove_lapsed_guardians( uint16_t max )
+   {
+      // guardians which did not reassert their vote within reassertion period stop earning per-stake rewards
+      auto idx = _guardians.get_index<"byreassert"_n>();
+      const auto lapsed_since = current_time_point() - _gpicostate->reassertion_period;
+      for ( ; max > 0; --max ) {
+         auto itr = idx.begin();
+         if ( itr == idx.end() || itr->guardian_stake == 0 || itr->last_reassertion_time > lapsed_since ) {
+            break;
+         }
+
+         _ghotstate.modify().total_guardians_stake -= itr->guardian_stake;
+         idx.modify( itr, same_payer, [&]( auto& g ) {
+            settle_perstake_reward( g );
+            g.guardian_stake = 0;
+         });
+         if ( itr->pending_reward == 0 ) {
+            idx.erase( itr );
+         }
+      }
+   }
+
+   void system_contract::rescan_guardian_stakes( uint16_t max )
+   {
+      // voters are visited by name, so the batch boundary does not depend on how many voters share a stake
+      if ( _ggrdrescan->lower >= _ggrdrescan->upper ) {
+         return;
+      }
+
+      auto& rescan = _ggrdrescan.modify();
+      auto it = _voter_stakes.lower_bound( rescan.cursor.value );
+      for ( ; it != _voter_stakes.end() && max > 0; ++it, --max ) {
+         if ( rescan.lower <= it->staked && it->staked < rescan.upper ) {
+            update_guardian_stake( *it );
+         }
+      }
+
+      if ( it == _voter_stakes.end() ) {
+         rescan = guardian_rescan_state{};
+      } else {
+         rescan.cursor = it->owner;
+      }
+   }
+
+   void system_contract::init_round_ledger()
+   {
+      // after upgrade the ledger adopts counters of the producers from the current schedule
+      auto& ledger = _groundledger.modify();
+      for (const auto& p: _gstate->last_schedule) {
+         const auto counters = get_producer_counters(p.first);
+         ledger.slots.push_back(round_ledger_slot{
+            .producer                             = counters->owner,
+            .current_round_unpaid_blocks          = counters->current_round_unpaid_blocks,
+            .last_expected_produced_blocks_update = counters->last_expected_produced_blocks_update,
+            .last_block_time                      = counters->last_block_time });
+         if (counters->current_round_unpaid_blocks > 0) {
+            _producer_counters.modify(counters, same_payer, [&](auto& c) {
+               c.current_round_unpaid_blocks = 0;
+            });
+         }
+      }
+   }
+
+   void system_contract::update_round_ledger( const std::vector<name>& active_producers, const block_timestamp& timestamp )
+   {
+      auto& ledger = _groundledger.modify();
+      const auto& ghotstate = _ghotstate.get();
+      for (size_t producer_index = 0; producer_index < ledger.slots.size(); producer_index++) {
+         auto& slot = ledger.slots[producer_index];
+
+         //blocks from full rounds
+         const auto full_rounds_passed = (timestamp.slot - slot.last_expected_produced_blocks_update.slot) / blocks_per_round;
+         uint32_t expected_produced_blocks = full_rounds_passed * producer_repetitions;
+         if ((timestamp.slot - slot.last_expected_produced_blocks_update.slot) % blocks_per_round != 0) {
+            //if last round is incomplete, calculate number of blocks produced in this round by prod
+            const auto current_round_start_position = ghotstate.current_round_start_time.slot % blocks_per_round;
+            const auto producer_first_block_position = producer_repetitions * producer_index;
+            const uint32_t current_round_blocks_before_producer_start_producing = current_round_start_position <= producer_first_block_position ?
+                                                                                  producer_first_block_position - current_round_start_position :
+                                                                                  blocks_per_round - (current_round_start_position - producer_first_block_position);
+
+            const auto total_current_round_blocks = timestamp.slot - ghotstate.current_round_start_time.slot;
+            if (current_round_blocks_before_producer_start_producing < total_current_round_blocks) {
+               expected_produced_blocks += std::min(total_current_round_blocks - current_round_blocks_before_producer_start_producing, uint32_t(producer_repetitions));
+            } else if (blocks_per_round - current_round_blocks_before_producer_start_producing < producer_repetitions) {
+               expected_produced_blocks += std::min(producer_repetitions - (blocks_per_round - current_round_blocks_before_producer_start_producing), total_current_round_blocks);
+            }
+         }
+         slot.expected_produced_blocks += expected_produced_blocks;
+         slot.last_expected_produced_blocks_update = timestamp;
+         slot.unpaid_blocks += slot.current_round_unpaid_blocks;
+         slot.current_round_unpaid_blocks = 0;
+      }
+
+      std::vector<round_ledger_slot> slots;
+      slots.reserve(active_producers.size());
+      for (const auto& producer: active_producers) {
+         auto prev = std::find_if(std::begin(ledger.slots), std::end(ledger.slots),
+                                  [&producer](const auto& element) { return element.producer == producer; });
+         if (prev != std::end(ledger.slots)) {
+            slots.push_back(*prev);
+            prev->producer = name{};
+            continue;
+         }
+
+         const auto counters = get_producer_counters(producer);
+         slots.push_back(round_ledger_slot{
+            .producer                             = producer,
+            .current_round_unpaid_blocks          = counters->current_round_unpaid_blocks,
+            .last_expected_produced_blocks_update = timestamp,
+            .last_block_time                      = counters->last_block_time });
+         if (counters->current_round_unpaid_blocks > 0) {
+            _producer_counters.modify(counters, same_payer, [&](auto& c) {
+               c.current_round_unpaid_blocks = 0;
+            });
+         }
+         _producers.modify(_producers.get(producer.value), same_payer, [&](auto& p) {
+            p.top21_chosen_time = current_time_point();
+         });
+      }
+
+      // producers that left the schedule keep their counters in the producer counters table
+      for (const auto& slot: ledger.slots) {
+         if (slot.producer) {
+            _producer_counters.modify(get_producer_counters(slot.producer), same_payer, [&](auto& c) {
+               c.unpaid_blocks += slot.unpaid_blocks;
+               c.expected_produced_blocks += slot.expected_produced_blocks;
+               c.last_expected_produced_blocks_update = slot.last_expected_produced_blocks_update;
+               c.last_block_time = slot.last_block_time;
+            });
+            _producers.modify(_producers.get(slot.producer.value), same_payer, [&](auto& p) {
+               p.top21_chosen_time = time_point(picoio::seconds(0));
+            });
+         }
+      }
+      ledger.slots = std::move(slots);
+   }
+
+   producer_counters_table::const_iterator system_contract::get_producer_counters( const name& producer )
+   {
+      auto counters = _producer_counters.find(producer.value);
+      if (counters != _producer_counters.end()) {
+         return counters;
+      }
+
+      // producers that were not migrated yet start from the counters left in the producers table
+      const auto& prod = _producers.get(producer.value, "producer not found");
+      counters = _producer_counters.emplace(get_self(), [&](auto& c) {
+         c.owner                                = prod.owner;
+         c.current_round_unpaid_blocks          = prod.current_round_unpaid_blocks;
+         c.unpaid_blocks                        = prod.unpaid_blocks;
+         c.expected_produced_blocks             = prod.expected_produced_blocks;
+         c.last_expected_produced_blocks_update = prod.last_expected_produced_blocks_update;
+         c.pending_pervote_reward               = prod.pending_pervote_reward;
+         c.last_block_time                      = prod.last_block_time;
+      });
+
+      // legacy counters are cleared, so readers of the producers table do not see frozen values
+      _producers.modify(prod, same_payer, [&](auto& p) {
+         p.current_round_unpaid_blocks          = 0;
+         p.unpaid_blocks                        = 0;
+         p.expected_produced_blocks             = 0;
+         p.last_expected_produced_blocks_update = block_timestamp();
+         p.pending_pervote_reward               = 0;
+         p.last_block_time                      = time_point();
+      });
+      return counters;
+   }
+
+   time_point system_contract::get_last_block_time( const name& producer ) const
+   {
+      const auto& slots = _groundledger->slots;
+      auto slot = std::find_if(std::begin(slots), std::end(slots),
+                               [&producer](const auto& element) { return element.producer == producer; });
+      if (slot != std::end(slots)) {
+         return slot->last_block_time;
+      }
+      auto counters = _producer_counters.find(producer.value);
+      return counters != _producer_counters.end() ? counters->last_block_time : _producers.get(producer.value).last_block_time;
+   }
+
    void system_contract::onblock( ignore<block_header> ) {
       using namespace picoio;
 
@@ -127,131 +447,93 @@ namespace picoiosystem {
       uint32_t schedule_version = 0;
       _ds >> timestamp >> producer >> confirmed >> previous >> transaction_mroot >> action_mroot >> schedule_version;
 
-      // _gstate2.last_block_num is not used anywhere in the system contract code anymore.
+      // _gstate2->last_block_num is not used anywhere in the system contract code anymore.
       // Although this field is deprecated, we will continue updating it for now until the last_block_num field
       // is eventually completely picooved, at which point this line can be picooved.
-      _gstate2.last_block_num = timestamp;
+      _gstate2.modify().last_block_num = timestamp;
 
       /** until activated stake crosses this threshold no new rewards are paid */
-      if( _gstate.total_activated_stake < min_activated_stake )
+      if( _ghotstate->total_activated_stake < min_activated_stake )
          return;
 
+      if ( _groundledger->slots.empty() && !_gstate->last_schedule.empty() ) {
+         init_round_ledger();
+      }
+
       //end of round: count all unpaid blocks produced within this round
-      if (timestamp.slot >= _gstate.current_round_start_time.slot + blocks_per_round) {
-         const auto rounds_passed = (timestamp.slot - _gstate.current_round_start_time.slot) / blocks_per_round;
-         _gstate.current_round_start_time = block_timestamp(_gstate.current_round_start_time.slot + (rounds_passed * blocks_per_round));
-         for (const auto p: _gstate.last_schedule) {
-            const auto& prod = _producers.get(p.first.value);
-            _producers.modify(prod, same_payer, [&](auto& p) {
-               p.unpaid_blocks += p.current_round_unpaid_blocks;
-               p.current_round_unpaid_blocks = 0;
-            });
+      if (timestamp.slot >= _ghotstate->current_round_start_time.slot + blocks_per_round) {
+         const auto rounds_passed = (timestamp.slot - _ghotstate->current_round_start_time.slot) / blocks_per_round;
+         _ghotstate.modify().current_round_start_time = block_timestamp(_ghotstate->current_round_start_time.slot + (rounds_passed * blocks_per_round));
+         for (auto& slot: _groundledger.modify().slots) {
+            slot.unpaid_blocks += slot.current_round_unpaid_blocks;
+            slot.current_round_unpaid_blocks = 0;
          }
       }
 
-      if (schedule_version > _gstate.last_schedule_version) {
+      if (schedule_version > _ghotstate->last_schedule_version) {
          std::vector<name> active_producers = picoio::get_active_producers();
-         for (size_t producer_index = 0; producer_index < _gstate.last_schedule.size(); producer_index++) {
-            const auto producer_name = _gstate.last_schedule[producer_index].first;
-            const auto& prod = _producers.get(producer_name.value);
-
-            if( std::find(active_producers.begin(), active_producers.end(), producer_name) == active_producers.end() ) {
-              _producers.modify(prod, same_payer, [&](auto& p) {
-                 p.top21_chosen_time = time_point(picoio::seconds(0));
-              });
-            }
+         update_round_ledger( active_producers, timestamp );
 
-            //blocks from full rounds
-            const auto full_rounds_passed = (timestamp.slot - prod.last_expected_produced_blocks_update.slot) / blocks_per_round;
-            uint32_t expected_produced_blocks = full_rounds_passed * producer_repetitions;
-            if ((timestamp.slot - prod.last_expected_produced_blocks_update.slot) % blocks_per_round != 0) {
-               //if last round is incomplete, calculate number of blocks produced in this round by prod
-               const auto current_round_start_position = _gstate.current_round_start_time.slot % blocks_per_round;
-               const auto producer_first_block_position = producer_repetitions * producer_index;
-               const uint32_t current_round_blocks_before_producer_start_producing = current_round_start_position <= producer_first_block_position ?
-                                                                                     producer_first_block_position - current_round_start_position :
-                                                                                     blocks_per_round - (current_round_start_position - producer_first_block_position);
-
-               const auto total_current_round_blocks = timestamp.slot - _gstate.current_round_start_time.slot;
-               if (current_round_blocks_before_producer_start_producing < total_current_round_blocks) {
-                  expected_produced_blocks += std::min(total_current_round_blocks - current_round_blocks_before_producer_start_producing, uint32_t(producer_repetitions));
-               } else if (blocks_per_round - current_round_blocks_before_producer_start_producing < producer_repetitions) {
-                  expected_produced_blocks += std::min(producer_repetitions - (blocks_per_round - current_round_blocks_before_producer_start_producing), total_current_round_blocks);
-               }
-            }
-            _producers.modify(prod, same_payer, [&](auto& p) {
-               p.expected_produced_blocks += expected_produced_blocks;
-               p.last_expected_produced_blocks_update = timestamp;
-               p.unpaid_blocks += p.current_round_unpaid_blocks;
-               p.current_round_unpaid_blocks = 0;
-            });
-         }
+         auto& ghotstate = _ghotstate.modify();
+         ghotstate.current_round_start_time = timestamp;
+         ghotstate.last_schedule_version = schedule_version;
 
-         _gstate.current_round_start_time = timestamp;
-         _gstate.last_schedule_version = schedule_version;
-
-         for (size_t i = 0; i < active_producers.size(); i++) {
-            const auto& prod_name = active_producers[i];
-            const auto& prod = _producers.get(prod_name.value);
-            auto res = std::find_if(_gstate.last_schedule.begin(),
-                                    _gstate.last_schedule.end(),
-                                    [&prod_name](const std::pair<picoio::name, double>& element){ return element.first == prod_name;});
-            if( res == _gstate.last_schedule.end() ) {
-              _producers.modify(prod, same_payer, [&](auto& p) {
-                 p.top21_chosen_time = current_time_point();
-              });
-            }
-         }
-
-         if (active_producers.size() != _gstate.last_schedule.size()) {
-            _gstate.last_schedule.resize(active_producers.size());
+         auto& gstate = _gstate.modify();
+         if (active_producers.size() != gstate.last_schedule.size()) {
+            gstate.last_schedule.resize(active_producers.size());
          }
          for (size_t i = 0; i < active_producers.size(); i++) {
-            const auto& prod_name = active_producers[i];
-            const auto& prod = _producers.get(prod_name.value);
-            _gstate.last_schedule[i] = std::make_pair(prod_name, 0.0);
-            _producers.modify(prod, same_payer, [&](auto& p) {
-               p.last_expected_produced_blocks_update = timestamp;
-            });
+            gstate.last_schedule[i] = std::make_pair(active_producers[i], 0.0);
          }
          get_rotated_schedule();
          update_standby();
-         update_pervote_shares();
+         _ghotstate.modify().pervote_shares_changed = true;
       }
 
-      if( _gstate.last_pervote_bucket_fill == time_point() )  /// start the presses
-         _gstate.last_pervote_bucket_fill = current_time_point();
+      if( _ghotstate->last_pervote_bucket_fill == time_point() )  /// start the presses
+         _ghotstate.modify().last_pervote_bucket_fill = current_time_point();
 
 
       /**
        * At startup the initial producer may not be one that is registered / elected
        * and therefore there may be no producer object for them.
        */
-      auto prod = _producers.find( producer.value );
-      if ( prod != _producers.end() ) {
-         _gstate.total_unpaid_blocks++;
-
-         _producers.modify( prod, same_payer, [&](auto& p ) {
-               p.current_round_unpaid_blocks++;
-               p.last_block_time = timestamp;
-         });
+      const auto& ledger_slots = _groundledger->slots;
+      const auto ledger_slot = std::find_if(std::begin(ledger_slots), std::end(ledger_slots),
+                                            [&producer](const auto& element) { return element.producer == producer; });
+      if ( ledger_slot != std::end(ledger_slots) || _producers.find( producer.value ) != _producers.end() ) {
+         _ghotstate.modify().total_unpaid_blocks++;
+
+         // last block time is kept only in the round ledger or in the producer counters, see `get_last_block_time`
+         if ( ledger_slot != std::end(ledger_slots) ) {
+            auto& slot = _groundledger.modify().slots[std::distance(std::begin(ledger_slots), ledger_slot)];
+            slot.current_round_unpaid_blocks++;
+            slot.last_block_time = timestamp;
+         } else {
+            _producer_counters.modify( get_producer_counters( producer ), same_payer, [&](auto& c ) {
+                  c.current_round_unpaid_blocks++;
+                  c.last_block_time = timestamp;
+            });
+         }
       }
 
       /// only update block producers once every minute, block_timestamp is in half seconds
-      if( timestamp.slot - _gstate.last_producer_schedule_update.slot > 120 ) {
+      if( timestamp.slot - _ghotstate->last_producer_schedule_update.slot > 120 ) {
          update_elected_producers( timestamp );
+         remove_lapsed_guardians( lapsed_guardians_per_action );
+         rescan_guardian_stakes( rescanned_voters_per_action );
 
-         if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
+         if( (timestamp.slot - _gstate->last_name_close.slot) > blocks_per_day ) {
             name_bid_table bids(get_self(), get_self().value);
             auto idx = bids.get_index<"highbid"_n>();
             auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
             if( highest != idx.end() &&
                 highest->high_bid > 0 &&
                 (current_time_point() - highest->last_bid_time) > microseconds(useconds_per_day) &&
-                _gstate.thresh_activated_stake_time > time_point() &&
-                (current_time_point() - _gstate.thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
+                _gstate->thresh_activated_stake_time > time_point() &&
+                (current_time_point() - _gstate->thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
             ) {
-               _gstate.last_name_close = timestamp;
+               _gstate.modify().last_name_close = timestamp;
                channel_namebid_to_rex( highest->high_bid );
                idx.modify( highest, same_payer, [&]( auto& b ){
                   b.high_bid = -b.high_bid;
@@ -266,21 +548,40 @@ namespace picoiosystem {
    void system_contract::claim_perstake( const name& guardian )
    {
       const auto& voter = _voters.get( guardian.value );
+      const auto stake_itr = get_voter_stake( guardian );
 
       const auto ct = current_time_point();
-      check( ct - voter.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
+      check( ct - stake_itr->last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
+
+      // voters that were not migrated yet may still have a legacy pending reward
+      int64_t pending_perstake_reward = voter.pending_perstake_reward;
+      auto guardian_itr = _guardians.find( guardian.value );
+      if ( guardian_itr != _guardians.end() ) {
+         _guardians.modify( guardian_itr, same_payer, [&](auto& g) {
+            settle_perstake_reward( g );
+            pending_perstake_reward += g.pending_reward;
+            g.pending_reward = 0;
+         });
+         if ( guardian_itr->guardian_stake == 0 ) {
+            _guardians.erase( guardian_itr );
+         }
+      }
 
-      _gstate.perstake_bucket -= voter.pending_perstake_reward;
+      _ghotstate.modify().perstake_bucket -= pending_perstake_reward;
 
-      if ( voter.pending_perstake_reward > 0 ) {
+      if ( pending_perstake_reward > 0 ) {
          token::transfer_action transfer_act{ token_account, { {spay_account, active_permission}, {guardian, active_permission} } };
-         transfer_act.send( spay_account, guardian, asset(voter.pending_perstake_reward, core_symbol()), "guardian stake pay" );
+         transfer_act.send( spay_account, guardian, asset(pending_perstake_reward, core_symbol()), "guardian stake pay" );
       }
 
-      _voters.modify( voter, same_payer, [&](auto& v) {
-         v.last_claim_time         = ct;
-         v.pending_perstake_reward = 0;
+      _voter_stakes.modify( stake_itr, same_payer, [&](auto& s) {
+         s.last_claim_time = ct;
       });
+      if ( voter.pending_perstake_reward != 0 ) {
+         _voters.modify( voter, same_payer, [&](auto& v) {
+            v.pending_perstake_reward = 0;
+         });
+      }
 
    }
 
@@ -291,43 +592,65 @@ namespace picoiosystem {
       const auto ct = current_time_point();
       check( ct - prod.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
 
-      int64_t producer_per_vote_pay = prod.pending_pervote_reward;
-      auto expected_produced_blocks = prod.expected_produced_blocks;
-      if (std::find_if(std::begin(_gstate.last_schedule), std::end(_gstate.last_schedule),
-            [&producer](const auto& prod){ return prod.first.value == producer.value; }) != std::end(_gstate.last_schedule)) {
-         const auto full_rounds_passed = (_gstate.current_round_start_time.slot - prod.last_expected_produced_blocks_update.slot) / blocks_per_round;
-         expected_produced_blocks += full_rounds_passed * producer_repetitions;
+      const auto counters = get_producer_counters( producer );
+      int64_t pending_pervote_reward = counters->pending_pervote_reward;
+      auto& slots = _gpervotepay.modify().slots;
+      auto slot = std::find_if(std::begin(slots), std::end(slots),
+                               [&producer](const auto& element) { return element.producer == producer; });
+      if (slot != std::end(slots)) {
+         pending_pervote_reward += slot->unsettled_reward;
+         slot->unsettled_reward = 0;
       }
-      if (prod.unpaid_blocks != expected_produced_blocks && expected_produced_blocks > 0) {
-         producer_per_vote_pay = (prod.pending_pervote_reward * prod.unpaid_blocks) / expected_produced_blocks;
+
+      // scheduled producers keep their block counters in the round ledger
+      auto unpaid_blocks = counters->unpaid_blocks;
+      auto expected_produced_blocks = counters->expected_produced_blocks;
+      auto& ledger_slots = _groundledger.modify().slots;
+      auto ledger_slot = std::find_if(std::begin(ledger_slots), std::end(ledger_slots),
+                                      [&producer](const auto& element) { return element.producer == producer; });
+      if (ledger_slot != std::end(ledger_slots)) {
+         const auto full_rounds_passed = (_ghotstate->current_round_start_time.slot - ledger_slot->last_expected_produced_blocks_update.slot) / blocks_per_round;
+         unpaid_blocks += ledger_slot->unpaid_blocks;
+         expected_produced_blocks += ledger_slot->expected_produced_blocks + full_rounds_passed * producer_repetitions;
+         ledger_slot->unpaid_blocks = 0;
+         ledger_slot->expected_produced_blocks = 0;
+         ledger_slot->last_expected_produced_blocks_update = _ghotstate->current_round_start_time;
+      }
+
+      int64_t producer_per_vote_pay = pending_pervote_reward;
+      if (unpaid_blocks != expected_produced_blocks && expected_produced_blocks > 0) {
+         producer_per_vote_pay = (pending_pervote_reward * unpaid_blocks) / expected_produced_blocks;
       }
-      const auto punishment = prod.pending_pervote_reward - producer_per_vote_pay;
+      const auto punishment = pending_pervote_reward - producer_per_vote_pay;
 
       if ( producer_per_vote_pay > 0 ) {
          token::transfer_action transfer_act{ token_account, { {vpay_account, active_permission}, {producer, active_permission} } };
          transfer_act.send( vpay_account, producer, asset(producer_per_vote_pay, core_symbol()), "producer vote pay" );
       }
       if ( punishment > 0 ) {
-         string punishment_memo = "punishment transfer: missed " + std::to_string(expected_produced_blocks - prod.unpaid_blocks) + " blocks out of " + std::to_string(expected_produced_blocks);
+         string punishment_memo = "punishment transfer: missed " + std::to_string(expected_produced_blocks - unpaid_blocks) + " blocks out of " + std::to_string(expected_produced_blocks);
          token::transfer_action transfer_act{ token_account, { {vpay_account, active_permission} } };
          transfer_act.send( vpay_account, saving_account, asset(punishment, core_symbol()), punishment_memo );
       }
 
-      _gstate.pervote_bucket      -= producer_per_vote_pay;
-      _gstate.total_unpaid_blocks -= prod.unpaid_blocks;
+      auto& ghotstate = _ghotstate.modify();
+      ghotstate.pervote_bucket      -= producer_per_vote_pay;
+      ghotstate.total_unpaid_blocks -= unpaid_blocks;
 
+      _producer_counters.modify( counters, same_payer, [&](auto& c) {
+         c.last_expected_produced_blocks_update = _ghotstate->current_round_start_time;
+         c.unpaid_blocks                        = 0;
+         c.expected_produced_blocks             = 0;
+         c.pending_pervote_reward               = 0;
+      });
       _producers.modify( prod, same_payer, [&](auto& p) {
-         p.last_claim_time                      = ct;
-         p.last_expected_produced_blocks_update = _gstate.current_round_start_time;
-         p.unpaid_blocks                        = 0;
-         p.expected_produced_blocks             = 0;
-         p.pending_pervote_reward               = 0;
+         p.last_claim_time = ct;
       });
    }
 
    void system_contract::claimrewards( const name& owner ) {
       require_auth( owner );
-      check( _gstate.total_activated_stake >= min_activated_stake, "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
+      check( _ghotstate->total_activated_stake >= min_activated_stake, "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
 
       auto voter = _voters.find( owner.value );
       if( voter != _voters.end() ) {
@@ -340,14 +663,57 @@ namespace picoiosystem {
       }
    }
 
+   void system_contract::migrperstake( const name& from, uint16_t max ) {
+      require_auth( get_self() );
+
+      for ( auto voter = _voters.lower_bound( from.value ); voter != _voters.end() && max > 0; ++voter, --max ) {
+         update_guardian_stake( *get_voter_stake( voter->owner ) );
+         if ( voter->pending_perstake_reward == 0 ) {
+            continue;
+         }
+
+         auto guardian = _guardians.find( voter->owner.value );
+         if ( guardian == _guardians.end() ) {
+            _guardians.emplace( get_self(), [&]( auto& g ) {
+               g.owner            = voter->owner;
+               g.reward_per_share = get_perstake_reward_per_share();
+               g.pending_reward   = voter->pending_perstake_reward;
+            });
+         } else {
+            _guardians.modify( guardian, same_payer, [&]( auto& g ) {
+               g.pending_reward += voter->pending_perstake_reward;
+            });
+         }
+         _voters.modify( voter, same_payer, [&]( auto& v ) {
+            v.pending_perstake_reward = 0;
+         });
+      }
+   }
+
+   void system_contract::migrprodctrs( const name& producer, uint16_t max ) {
+      require_auth( get_self() );
+
+      for ( auto prod = _producers.lower_bound( producer.value ); prod != _producers.end() && max > 0; ++prod, --max ) {
+         get_producer_counters( prod->owner );
+      }
+   }
+
+   void system_contract::migrvoters( const name& from, uint16_t max ) {
+      require_auth( get_self() );
+
+      for ( auto voter = _voters.lower_bound( from.value ); voter != _voters.end() && max > 0; ++voter, --max ) {
+         get_voter_stake( voter->owner );
+      }
+   }
+
    void system_contract::torewards( const name& payer, const asset& amount ) {
       require_auth( payer );
       check( amount.is_valid(), "invalid amount" );
       check( amount.symbol == core_symbol(), "invalid symbol" );
       check( amount.amount > 0, "amount must be positive" );
 
-      const auto to_per_stake_pay = share_perstake_reward_between_guardians( amount.amount * _gpicostate.per_stake_share );
-      const auto to_per_vote_pay  = share_pervote_reward_between_producers( amount.amount * _gpicostate.per_vote_share );
+      const auto to_per_stake_pay = share_perstake_reward_between_guardians( amount.amount * _gpicostate->per_stake_share );
+      const auto to_per_vote_pay  = share_pervote_reward_between_producers( amount.amount * _gpicostate->per_vote_share );
       const auto to_pico           = amount.amount - (to_per_stake_pay + to_per_vote_pay);
       if( amount.amount > 0 ) {
         token::transfer_action transfer_act{ token_account, { {payer, active_permission} } };
@@ -362,8 +728,9 @@ namespace picoiosystem {
         }
       }
 
-      _gstate.pervote_bucket          += to_per_vote_pay;
-      _gstate.perstake_bucket         += to_per_stake_pay;
+      auto& ghotstate = _ghotstate.modify();
+      ghotstate.pervote_bucket          += to_per_vote_pay;
+      ghotstate.perstake_bucket         += to_per_stake_pay;
    }
 
 } //namespace picoiosystem
@@ -1,6 +1,7 @@
 #include <pico.system/pico.system.hpp>
 #include <pico.token/pico.token.hpp>
 #include <pico.system/rex.results.hpp>
+#include <pico.system/rex_math.hpp>
 
 namespace picoiosystem {
 
@@ -52,7 +53,7 @@ namespace picoiosystem {
       transfer_from_fund( from, amount );
       const asset rex_received    = add_to_rex_pool( amount );
       const asset delta_rex_stake = add_to_rex_balance( from, amount, rex_received );
-      runrex(2);
+      runrex_if_backlogged();
       update_rex_account( from, asset( 0, core_symbol() ), delta_rex_stake );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
       rex_results::buyresult_action buyrex_act( rex_account, std::vector<picoio::permission_level>{ } );
@@ -94,7 +95,7 @@ namespace picoiosystem {
       }
       const asset rex_received = add_to_rex_pool( payment );
       add_to_rex_balance( owner, payment, rex_received );
-      runrex(2);
+      runrex_if_backlogged();
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ), true );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
       rex_results::buyresult_action buyrex_act( rex_account, std::vector<picoio::permission_level>{ } );
@@ -107,7 +108,7 @@ namespace picoiosystem {
 
       require_auth( from );
 
-      runrex(2);
+      runrex_if_backlogged();
 
       auto bitr = _rexbalance.require_find( from.value, "user must first buyrex" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol,
@@ -186,6 +187,39 @@ namespace picoiosystem {
       update_resource_limits( from, receiver, rented_tokens, 0 );
    }
 
+   void system_contract::quoterent( const asset& loan_payment )
+   {
+      check( false, "REX is not supported" );
+
+      check( rex_loans_available(), "rex loans are currently not available" );
+      check( loan_payment.symbol == core_symbol(), "must use core token" );
+      check( 0 < loan_payment.amount, "must use positive asset amount" );
+
+      const auto& pool = _rexpool.begin();
+      const int64_t rented_tokens = get_bancor_output( pool->total_rent.amount, pool->total_unlent.amount, loan_payment.amount );
+      check( loan_payment.amount < rented_tokens, "loan price does not favor renting" );
+
+      rex_results::rentquote_action rentquote_act{ rex_account, std::vector<picoio::permission_level>{ } };
+      rentquote_act.send( asset{ rented_tokens, core_symbol() } );
+   }
+
+   void system_contract::quotesell( const name& owner, const asset& rex )
+   {
+      check( false, "REX is not supported" );
+
+      check( rex_available(), "rex system is not initialized" );
+      const auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
+      check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
+
+      auto maturities = bitr->rex_maturities;
+      const int64_t matured_rex = bitr->matured_rex + maturities.take_matured( rex_maturity_ring::day_of( current_time_point() ) );
+      check( rex.amount <= matured_rex, "insufficient available rex" );
+
+      const auto outcome = get_rex_order_outcome( *_rexpool.begin(), *bitr, rex );
+      rex_results::sellquote_action sellquote_act{ rex_account, std::vector<picoio::permission_level>{ } };
+      sellquote_act.send( outcome.proceeds, outcome.stake_change, !outcome.success );
+   }
+
    void system_contract::fundcpuloan( const name& from, uint64_t loan_num, const asset& payment )
    {
       check( false, "REX is not supported" );
@@ -232,7 +266,7 @@ namespace picoiosystem {
 
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_backlogged();
 
       auto itr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       const asset init_stake = itr->vote_stake;
@@ -244,7 +278,7 @@ namespace picoiosystem {
 
       asset current_stake( 0, core_symbol() );
       if ( total_rex > 0 ) {
-         current_stake.amount = ( uint128_t(rex_balance) * total_lendable ) / total_rex;
+         current_stake.amount = rex_to_core( rex_balance, total_lendable, total_rex );
       }
       _rexbalance.modify( itr, same_payer, [&]( auto& rb ) {
          rb.vote_stake = current_stake;
@@ -275,6 +309,25 @@ namespace picoiosystem {
       require_auth( user );
 
       runrex( max );
+
+      const auto backlog = get_rex_backlog( rex_maintenance_state::rex_backlog_scan_limit );
+      auto& maint = _grexmaint.modify();
+      maint.cpu_loan_backlog   = backlog.cpu_loans;
+      maint.net_loan_backlog   = backlog.net_loans;
+      maint.sell_order_backlog = backlog.sell_orders;
+      maint.last_run_time      = current_time_point();
+   }
+
+   void system_contract::setrexmaint( uint16_t backlog_threshold, uint16_t max )
+   {
+      check( false, "REX is not supported" );
+
+      require_auth( get_self() );
+
+      check( max > 0, "max must be positive" );
+      auto& maint = _grexmaint.modify();
+      maint.user_backlog_threshold = backlog_threshold;
+      maint.user_max               = max;
    }
 
    void system_contract::consolidate( const name& owner )
@@ -283,7 +336,7 @@ namespace picoiosystem {
 
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_backlogged();
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       asset rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
@@ -296,7 +349,7 @@ namespace picoiosystem {
 
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_backlogged();
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
@@ -306,15 +359,7 @@ namespace picoiosystem {
              "insufficient REX balance" );
       process_rex_maturities( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         int64_t moved_rex = 0;
-         while ( !rb.rex_maturities.empty() && moved_rex < rex.amount) {
-            const int64_t drex = std::min( rex.amount - moved_rex, rb.rex_maturities.back().second );
-            rb.rex_maturities.back().second -= drex;
-            moved_rex                       += drex;
-            if ( rb.rex_maturities.back().second == 0 ) {
-               rb.rex_maturities.pop_back();
-            }
-         }
+         int64_t moved_rex = rb.rex_maturities.take_latest( rex.amount );
          if ( moved_rex < rex.amount ) {
             const int64_t drex = rex.amount - moved_rex;
             rb.matured_rex    -= drex;
@@ -332,7 +377,7 @@ namespace picoiosystem {
 
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_backlogged();
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
@@ -340,12 +385,7 @@ namespace picoiosystem {
       check( rex.amount <= rex_in_savings, "insufficient REX in savings" );
       process_rex_maturities( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex.amount;
-         } else {
-            rb.rex_maturities.emplace_back( maturity, rex.amount );
-         }
+         rb.rex_maturities.add( get_rex_maturity(), rex.amount );
       });
       put_rex_savings( bitr, rex_in_savings - rex.amount );
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
@@ -358,7 +398,7 @@ namespace picoiosystem {
       require_auth( owner );
 
       if ( rex_system_initialized() )
-         runrex(2);
+         runrex_if_backlogged();
 
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
 
@@ -390,6 +430,20 @@ namespace picoiosystem {
       }
    }
 
+   void system_contract::migrrexbal( const name& from, uint16_t max )
+   {
+      require_auth( get_self() );
+
+      for ( auto itr = _rexbalance.lower_bound( from.value ); itr != _rexbalance.end() && max > 0; ++itr, --max ) {
+         if ( itr->version < rex_balance::current_version ) {
+            // entries are always written in the current layout
+            _rexbalance.modify( itr, same_payer, [&]( auto& rb ) {
+               rb.version = rex_balance::current_version;
+            });
+         }
+      }
+   }
+
    /**
     * @brief Updates account NET and CPU resource limits
     *
@@ -538,17 +592,23 @@ namespace picoiosystem {
       return delta_stake;
    }
 
-   int64_t system_contract::get_bancor_output( int64_t inp_reserve, int64_t out_reserve, int64_t inp )
+   /**
+    * @brief Adds a loan to the hourly bucket of its expiration
+    */
+   void system_contract::add_loan_to_bucket( rex_loan_bucket_table& buckets, uint64_t loan_num, const time_point& expiration )
    {
-      const double ib = inp_reserve;
-      const double ob = out_reserve;
-      const double in = inp;
-
-      int64_t out = int64_t( (in * ob) / (ib + in) );
-
-      if ( out < 0 ) out = 0;
-
-      return out;
+      const auto bucket_expiration = rex_loan_bucket::bucket_expiration( expiration );
+      auto bitr = buckets.find( bucket_expiration.elapsed.count() );
+      if ( bitr == buckets.end() ) {
+         buckets.emplace( get_self(), [&]( auto& b ) {
+            b.expiration = bucket_expiration;
+            b.loan_nums.push_back( loan_num );
+         });
+      } else {
+         buckets.modify( bitr, same_payer, [&]( auto& b ) {
+            b.loan_nums.push_back( loan_num );
+         });
+      }
    }
 
    /**
@@ -592,81 +652,155 @@ namespace picoiosystem {
          return { delete_loan, delta_stake };
       };
 
-      /// transfer from pico.names to pico.rex
-      if ( pool->namebid_proceeds.amount > 0 ) {
-         channel_to_rex( names_account, pool->namebid_proceeds );
-         _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
-            rt.namebid_proceeds.amount = 0;
-         });
-      }
+      channel_namebid_proceeds();
 
-      /// process cpu loans
-      {
-         rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
-         auto cpu_idx = cpu_loans.get_index<"byexpr"_n>();
-         for ( uint16_t i = 0; i < max; ++i ) {
-            auto itr = cpu_idx.begin();
-            if ( itr == cpu_idx.end() || itr->expiration > current_time_point() ) break;
+      /// drains expired loan buckets in order, renewed loans move to the bucket of their new expiration
+      auto process_expired_loans = [&]( auto& loans, rex_loan_bucket_table& buckets, const auto& update_limits ) {
+         for ( uint16_t i = 0; i < max; ) {
+            auto bitr = buckets.begin();
+            if ( bitr == buckets.end() || bitr->expiration > current_time_point() ) break;
+
+            auto loan_nums = bitr->loan_nums;
+            for ( ; i < max && !loan_nums.empty(); ++i ) {
+               auto itr = loans.require_find( loan_nums.back(), "loan not found" ); // data corruption
+               loan_nums.pop_back();
+
+               auto result = process_expired_loan( loans, itr );
+               if ( result.second != 0 )
+                  update_limits( *itr, result.second );
 
-            auto result = process_expired_loan( cpu_idx, itr );
-            if ( result.second != 0 )
-               update_resource_limits( itr->from, itr->receiver, 0, result.second );
+               if ( result.first )
+                  loans.erase( itr );
+               else
+                  add_loan_to_bucket( buckets, itr->loan_num, itr->expiration );
+            }
 
-            if ( result.first )
-               cpu_idx.erase( itr );
+            if ( loan_nums.empty() ) {
+               buckets.erase( bitr );
+            } else {
+               buckets.modify( bitr, same_payer, [&]( auto& b ) {
+                  b.loan_nums = std::move( loan_nums );
+               });
+            }
          }
+      };
+
+      /// process cpu loans
+      {
+         rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
+         rex_loan_bucket_table cpu_buckets( get_self(), rex_cpu_loan_table::table_name().value );
+         process_expired_loans( cpu_loans, cpu_buckets, [&]( const rex_loan& loan, int64_t delta_stake ) {
+            update_resource_limits( loan.from, loan.receiver, 0, delta_stake );
+         });
       }
 
       /// process net loans
       {
          rex_net_loan_table net_loans( get_self(), get_self().value );
-         auto net_idx = net_loans.get_index<"byexpr"_n>();
-         for ( uint16_t i = 0; i < max; ++i ) {
-            auto itr = net_idx.begin();
-            if ( itr == net_idx.end() || itr->expiration > current_time_point() ) break;
-
-            auto result = process_expired_loan( net_idx, itr );
-            if ( result.second != 0 )
-               update_resource_limits( itr->from, itr->receiver, result.second, 0 );
-
-            if ( result.first )
-               net_idx.erase( itr );
-         }
+         rex_loan_bucket_table net_buckets( get_self(), rex_net_loan_table::table_name().value );
+         process_expired_loans( net_loans, net_buckets, [&]( const rex_loan& loan, int64_t delta_stake ) {
+            update_resource_limits( loan.from, loan.receiver, delta_stake, 0 );
+         });
       }
 
-      /// process sellrex orders
+      /// process sellrex orders, starting from the order where the previous pass stopped,
+      /// the batch is filled against an in-memory copy of the pool which is written back once
       if ( _rexorders.begin() != _rexorders.end() ) {
+         auto pool_state = *pool;
+         std::vector<std::pair<name, asset>> filled_orders;
          auto idx  = _rexorders.get_index<"bytime"_n>();
-         auto oitr = idx.begin();
+         auto oitr = idx.lower_bound( _grexmaint->sell_order_cursor );
+         if ( oitr == idx.end() || !oitr->is_open ) {
+            oitr = idx.begin();
+         }
          for ( uint16_t i = 0; i < max; ++i ) {
             if ( oitr == idx.end() || !oitr->is_open ) break;
             auto next = oitr;
             ++next;
             auto bitr = _rexbalance.find( oitr->owner.value );
             if ( bitr != _rexbalance.end() ) { // should always be true
-               auto result = fill_rex_order( bitr, oitr->rex_requested );
+               auto result = fill_rex_order( pool_state, bitr, oitr->rex_requested );
                if ( result.success ) {
-                  const name order_owner = oitr->owner;
+                  filled_orders.emplace_back( oitr->owner, result.proceeds );
                   idx.modify( oitr, same_payer, [&]( auto& order ) {
                      order.proceeds.amount     = result.proceeds.amount;
                      order.stake_change.amount = result.stake_change.amount;
                      order.close();
                   });
-                  /// send dummy action to show owner and proceeds of filled sellrex order
-                  rex_results::orderresult_action order_act( rex_account, std::vector<picoio::permission_level>{ } );
-                  order_act.send( order_owner, result.proceeds );
                }
             }
             oitr = next;
          }
+         if ( !filled_orders.empty() ) {
+            _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
+               rt = pool_state;
+            });
+            /// send dummy action to show owners and proceeds of filled sellrex orders
+            rex_results::ordersresult_action orders_act( rex_account, std::vector<picoio::permission_level>{ } );
+            orders_act.send( filled_orders );
+         }
+         const uint64_t cursor = oitr != idx.end() && oitr->is_open ? oitr->by_time() : 0;
+         if ( _grexmaint->sell_order_cursor != cursor ) {
+            _grexmaint.modify().sell_order_cursor = cursor;
+         }
+      }
+
+   }
+
+   void system_contract::runrex_if_backlogged()
+   {
+      check( rex_system_initialized(), "rex system not initialized yet" );
+
+      channel_namebid_proceeds();
+
+      // user actions only take over maintenance from rexexec when it falls behind
+      const auto& maint = _grexmaint.get();
+      if ( get_rex_backlog( maint.user_backlog_threshold + 1 ).deepest() > maint.user_backlog_threshold ) {
+         runrex( maint.user_max );
+      }
+   }
+
+   /**
+    * @brief Transfers accumulated name bid proceeds from pico.names to pico.rex
+    */
+   void system_contract::channel_namebid_proceeds()
+   {
+      const auto& pool = _rexpool.begin();
+      if ( pool->namebid_proceeds.amount > 0 ) {
+         channel_to_rex( names_account, pool->namebid_proceeds );
+         _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
+            rt.namebid_proceeds.amount = 0;
+         });
       }
+   }
+
+   rex_backlog system_contract::get_rex_backlog( uint32_t limit )const
+   {
+      const auto ct = current_time_point();
+      auto count_expired_loans = [&]( name loan_table ) {
+         const rex_loan_bucket_table buckets( get_self(), loan_table.value );
+         uint32_t count = 0;
+         for ( auto bitr = buckets.begin(); count < limit && bitr != buckets.end() && bitr->expiration <= ct; ++bitr ) {
+            count += bitr->loan_nums.size();
+         }
+         return std::min( count, limit );
+      };
 
+      rex_backlog backlog;
+      backlog.cpu_loans = count_expired_loans( rex_cpu_loan_table::table_name() );
+      backlog.net_loans = count_expired_loans( rex_net_loan_table::table_name() );
+
+      const auto orders = _rexorders.get_index<"bytime"_n>();
+      for ( auto oitr = orders.begin(); backlog.sell_orders < limit && oitr != orders.end() && oitr->is_open; ++oitr ) {
+         ++backlog.sell_orders;
+      }
+      return backlog;
    }
 
    template <typename T>
    int64_t system_contract::rent_rex( T& table, const name& from, const name& receiver, const asset& payment, const asset& fund )
    {
-      runrex(2);
+      runrex_if_backlogged();
 
       check( rex_loans_available(), "rex loans are currently not available" );
       check( payment.symbol == core_symbol() && fund.symbol == core_symbol(), "must use core token" );
@@ -682,7 +816,7 @@ namespace picoiosystem {
       check( payment.amount < rented_tokens, "loan price does not favor renting" );
       add_loan_to_rex_pool( payment, rented_tokens, true );
 
-      table.emplace( from, [&]( auto& c ) {
+      auto loan = table.emplace( from, [&]( auto& c ) {
          c.from         = from;
          c.receiver     = receiver;
          c.payment      = payment;
@@ -691,6 +825,8 @@ namespace picoiosystem {
          c.expiration   = current_time_point() + picoio::days(30);
          c.loan_num     = pool->loan_num;
       });
+      rex_loan_bucket_table buckets( get_self(), T::table_name().value );
+      add_loan_to_bucket( buckets, loan->loan_num, loan->expiration );
 
       rex_results::rentresult_action rentresult_act{ rex_account, std::vector<picoio::permission_level>{ } };
       rentresult_act.send( asset{ rented_tokens, core_symbol() } );
@@ -701,52 +837,75 @@ namespace picoiosystem {
     * @brief Processes a sellrex order and returns object containing the results
     *
     * Processes an incoming or already scheduled sellrex order. If REX pool has enough core
-    * tokens not frozen in loans, order is filled. In this case, REX pool totals, user rex_balance
-    * and user vote_stake are updated. However, this function does not update user voting power. The
+    * tokens not frozen in loans, order is filled. In this case, the given REX pool totals, user rex_balance
+    * and user vote_stake are updated. Writing the pool totals back is left to the caller, so that a batch
+    * of orders is filled with a single pool update. However, this function does not update user voting power. The
     * function returns success flag, order proceeds, and vote stake delta. These are used later in a
     * different function to complete order processing, i.e. transfer proceeds to user REX fund and
     * update user vote weight.
     *
+    * @param pool - REX pool totals the order is filled against, updated in memory only
     * @param bitr - iterator pointing to rex_balance database record
     * @param rex - amount of rex to be sold
     *
     * @return rex_order_outcome - a struct containing success flag, order proceeds, and resultant
     * vote stake change
     */
-   rex_order_outcome system_contract::fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex )
+   rex_order_outcome system_contract::fill_rex_order( rex_pool& pool, const rex_balance_table::const_iterator& bitr, const asset& rex )
    {
-      auto rexitr = _rexpool.begin();
-      const int64_t S0 = rexitr->total_lendable.amount;
-      const int64_t R0 = rexitr->total_rex.amount;
-      const int64_t p  = (uint128_t(rex.amount) * S0) / R0;
-      const int64_t R1 = R0 - rex.amount;
-      const int64_t S1 = S0 - p;
-      asset proceeds( p, core_symbol() );
-      asset stake_change( 0, core_symbol() );
-      bool  success = false;
-
-      const int64_t unlent_lower_bound = ( uint128_t(2) * rexitr->total_lent.amount ) / 10;
-      const int64_t available_unlent   = rexitr->total_unlent.amount - unlent_lower_bound; // available_unlent <= 0 is possible
-      if ( proceeds.amount <= available_unlent ) {
-         const int64_t init_vote_stake_amount = bitr->vote_stake.amount;
-         const int64_t current_stake_value    = ( uint128_t(bitr->rex_balance.amount) * S0 ) / R0;
-         _rexpool.modify( rexitr, same_payer, [&]( auto& rt ) {
-            rt.total_rex.amount      = R1;
-            rt.total_lendable.amount = S1;
-            rt.total_unlent.amount   = rt.total_lendable.amount - rt.total_lent.amount;
-         });
+      const auto outcome = get_rex_order_outcome( pool, *bitr, rex );
+      if ( outcome.success ) {
+         pool.total_rex.amount      -= rex.amount;
+         pool.total_lendable.amount -= outcome.proceeds.amount;
+         pool.total_unlent.amount    = pool.total_lendable.amount - pool.total_lent.amount;
          _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rb.vote_stake.amount   = current_stake_value - proceeds.amount;
+            rb.vote_stake.amount  += outcome.stake_change.amount;
             rb.rex_balance.amount -= rex.amount;
             rb.matured_rex        -= rex.amount;
          });
-         stake_change.amount = bitr->vote_stake.amount - init_vote_stake_amount;
-         success = true;
-      } else {
-         proceeds.amount = 0;
+      }
+      return outcome;
+   }
+
+   /**
+    * @brief Prices a sellrex order without changing any state
+    *
+    * @param pool - REX pool totals the order is priced against
+    * @param balance - rex_balance of the order owner
+    * @param rex - amount of rex to be sold
+    *
+    * @return rex_order_outcome - success flag is false if the order has to be queued, in which case
+    * proceeds and stake change are zero
+    */
+   rex_order_outcome system_contract::get_rex_order_outcome( const rex_pool& pool, const rex_balance& balance, const asset& rex )const
+   {
+      const int64_t S0 = pool.total_lendable.amount;
+      const int64_t R0 = pool.total_rex.amount;
+      const int64_t p  = rex_to_core( rex.amount, S0, R0 );
+
+      const int64_t unlent_lower_bound = ( uint128_t(2) * pool.total_lent.amount ) / 10;
+      const int64_t available_unlent   = pool.total_unlent.amount - unlent_lower_bound; // available_unlent <= 0 is possible
+      if ( available_unlent < p ) {
+         return { false, asset( 0, core_symbol() ), asset( 0, core_symbol() ) };
       }
 
-      return { success, proceeds, stake_change };
+      const int64_t current_stake_value = rex_to_core( balance.rex_balance.amount, S0, R0 );
+      return { true, asset( p, core_symbol() ), asset( current_stake_value - p - balance.vote_stake.amount, core_symbol() ) };
+   }
+
+   /**
+    * @brief Processes a sellrex order against the stored REX pool
+    */
+   rex_order_outcome system_contract::fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex )
+   {
+      auto pool = *_rexpool.begin();
+      const auto outcome = fill_rex_order( pool, bitr, rex );
+      if ( outcome.success ) {
+         _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& rt ) {
+            rt = pool;
+         });
+      }
+      return outcome;
    }
 
    template <typename T>
@@ -915,12 +1074,13 @@ namespace picoiosystem {
     */
    void system_contract::process_rex_maturities( const rex_balance_table::const_iterator& bitr )
    {
-      const time_point_sec now = current_time_point();
+      const uint32_t today = rex_maturity_ring::day_of( current_time_point() );
+      // legacy entries are rewritten in the current layout on the first touch
+      if ( bitr->rex_maturities.matured_buckets( today ) == 0 && bitr->version == rex_balance::current_version ) {
+         return;
+      }
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         while ( !rb.rex_maturities.empty() && rb.rex_maturities.front().first <= now ) {
-            rb.matured_rex += rb.rex_maturities.front().second;
-            rb.rex_maturities.pop_front();
-         }
+         rb.matured_rex += rb.rex_maturities.take_matured( today );
       });
    }
 
@@ -935,14 +1095,10 @@ namespace picoiosystem {
    {
       const int64_t rex_in_savings = read_rex_savings( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         int64_t total  = rb.matured_rex - rex_in_sell_order.amount;
+         int64_t total  = rb.matured_rex - rex_in_sell_order.amount + rb.rex_maturities.take_all();
          rb.matured_rex = rex_in_sell_order.amount;
-         while ( !rb.rex_maturities.empty() ) {
-            total += rb.rex_maturities.front().second;
-            rb.rex_maturities.pop_front();
-         }
          if ( total > 0 ) {
-            rb.rex_maturities.emplace_back( get_rex_maturity(), total );
+            rb.rex_maturities.add( get_rex_maturity(), total );
          }
       });
       put_rex_savings( bitr, rex_in_savings );
@@ -995,7 +1151,7 @@ namespace picoiosystem {
          const int64_t S0 = itr->total_lendable.amount;
          const int64_t S1 = S0 + payment.amount;
          const int64_t R0 = itr->total_rex.amount;
-         const int64_t R1 = (uint128_t(S1) * R0) / S0;
+         const int64_t R1 = core_to_rex( S1, S0, R0 );
          rex_received.amount = R1 - R0;
          _rexpool.modify( itr, same_payer, [&]( auto& rp ) {
             rp.total_lendable.amount = S1;
@@ -1033,8 +1189,8 @@ namespace picoiosystem {
          init_rex_stake.amount = bitr->vote_stake.amount;
          _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
             rb.rex_balance.amount += rex_received.amount;
-            rb.vote_stake.amount   = ( uint128_t(rb.rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
-                                     / _rexpool.begin()->total_rex.amount;
+            rb.vote_stake.amount   = rex_to_core( rb.rex_balance.amount, _rexpool.begin()->total_lendable.amount,
+                                                  _rexpool.begin()->total_rex.amount );
          });
          current_rex_stake.amount = bitr->vote_stake.amount;
       }
@@ -1042,12 +1198,7 @@ namespace picoiosystem {
       const int64_t rex_in_savings = read_rex_savings( bitr );
       process_rex_maturities( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex_received.amount;
-         } else {
-            rb.rex_maturities.emplace_back( maturity, rex_received.amount );
-         }
+         rb.rex_maturities.add( get_rex_maturity(), rex_received.amount );
       });
       put_rex_savings( bitr, rex_in_savings );
       return current_rex_stake - init_rex_stake;
@@ -1066,12 +1217,10 @@ namespace picoiosystem {
     */
    int64_t system_contract::read_rex_savings( const rex_balance_table::const_iterator& bitr )
    {
-      int64_t rex_in_savings = 0;
-      static const time_point_sec end_of_days = time_point_sec::maximum();
-      if ( !bitr->rex_maturities.empty() && bitr->rex_maturities.back().first == end_of_days ) {
+      int64_t rex_in_savings = bitr->rex_maturities.savings;
+      if ( rex_in_savings != 0 ) {
          _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rex_in_savings = rb.rex_maturities.back().second;
-            rb.rex_maturities.pop_back();
+            rb.rex_maturities.savings = 0;
          });
       }
       return rex_in_savings;
@@ -1086,13 +1235,8 @@ namespace picoiosystem {
    void system_contract::put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex )
    {
       if ( rex == 0 ) return;
-      static const time_point_sec end_of_days = time_point_sec::maximum();
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == end_of_days ) {
-            rb.rex_maturities.back().second += rex;
-         } else {
-            rb.rex_maturities.emplace_back( end_of_days, rex );
-         }
+         rb.rex_maturities.savings += rex;
       });
    }
 
@@ -1108,8 +1252,8 @@ namespace picoiosystem {
       if ( bitr != _rexbalance.end() && rex_available() ) {
          asset init_vote_stake = bitr->vote_stake;
          asset current_vote_stake( 0, core_symbol() );
-         current_vote_stake.amount = ( uint128_t(bitr->rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
-                                     / _rexpool.begin()->total_rex.amount;
+         current_vote_stake.amount = rex_to_core( bitr->rex_balance.amount, _rexpool.begin()->total_lendable.amount,
+                                                  _rexpool.begin()->total_rex.amount );
          _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
             rb.vote_stake.amount = current_vote_stake.amount;
          });
@@ -1117,11 +1261,12 @@ namespace picoiosystem {
       }
 
       if ( delta_stake != 0 ) {
-         auto vitr = _voters.find( voter.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& vinfo ) {
-               vinfo.staked += delta_stake;
+         if ( _voters.find( voter.value ) != _voters.end() ) {
+            const auto stake_itr = get_voter_stake( voter );
+            _voter_stakes.modify( stake_itr, same_payer, [&]( auto& s ) {
+               s.staked += delta_stake;
             });
+            update_guardian_stake( *stake_itr );
          }
       }
    }
@@ -6,6 +6,12 @@ void rex_results::sellresult( const asset& proceeds ) { }
 
 void rex_results::orderresult( const name& owner, const asset& proceeds ) { }
 
+void rex_results::ordersresult( const std::vector<std::pair<name, asset>>& orders ) { }
+
 void rex_results::rentresult( const asset& rented_tokens ) { }
 
+void rex_results::rentquote( const asset& rented_tokens ) { }
+
+void rex_results::sellquote( const asset& proceeds, const asset& stake_change, bool queued ) { }
+
 extern "C" void apply( uint64_t, uint64_t, uint64_t ) { }
@@ -14,18 +14,22 @@ namespace picoiosystem {
  *  we should not rotate him, so we reset rotation to current time point and schedule him for further rotations.
  */
 std::vector<picoio::producer_authority> system_contract::get_rotated_schedule() {
-   auto sorted_prods = _producers.get_index<"prototalvote"_n>();
+   const auto& ranked_prods = get_producer_ranking().producers;
+   // only the rows of the chosen producers are read for their authorities
+   auto to_authority = [this]( const ranked_producer& ranked ) {
+      const auto& prod = _producers.get( ranked.owner.value, "ranked producer not found" );
+      return picoio::producer_authority{
+         .producer_name = prod.owner,
+         .authority     = prod.producer_authority.has_value() ? *prod.producer_authority
+                                                              : convert_to_block_signing_authority( prod.producer_key ) };
+   };
 
    std::vector<picoio::producer_authority> top21_prods;
    top21_prods.reserve(max_block_producers);
 
-   auto prod_it = std::begin(sorted_prods);
-   for (; top21_prods.size() < max_block_producers
-         && 0 < prod_it->total_votes && prod_it->active() && prod_it != std::end(sorted_prods); ++prod_it) {
-      top21_prods.push_back( picoio::producer_authority{
-         .producer_name = prod_it->owner,
-         .authority     = prod_it->producer_authority.has_value() ? *prod_it->producer_authority
-                                                                  : convert_to_block_signing_authority( prod_it->producer_key ) } );
+   auto prod_it = std::begin(ranked_prods);
+   for (; top21_prods.size() < max_block_producers && prod_it != std::end(ranked_prods); ++prod_it) {
+      top21_prods.push_back( to_authority( *prod_it ) );
    }
 
    // nothing to rotate
@@ -37,8 +41,8 @@ std::vector<picoio::producer_authority> system_contract::get_rotated_schedule()
 
    // check if current top21 was in top21 in previous schedule
    const auto inTop21 = std::find_if(
-      std::begin(_gstate.last_schedule),
-      std::end(_gstate.last_schedule),
+      std::begin(_gstate->last_schedule),
+      std::end(_gstate->last_schedule),
       [top21Name = to_out.producer_name]( const auto& prod ){ 
          return prod.first == top21Name;
       }
@@ -46,8 +50,8 @@ std::vector<picoio::producer_authority> system_contract::get_rotated_schedule()
    
    // check if current top21 was in top25 in previous schedule
    const auto inTop25 = std::find_if(
-      std::begin(_grotation.standby_rotation),
-      std::end(_grotation.standby_rotation),
+      std::begin(_grotation->standby_rotation),
+      std::end(_grotation->standby_rotation),
       [top21Name = to_out.producer_name]( const auto& prod ){ 
          return prod.producer_name == top21Name;
       }
@@ -55,24 +59,22 @@ std::vector<picoio::producer_authority> system_contract::get_rotated_schedule()
 
    // if someone nor from top21 neither from top25 reached top21 then start rotation from now
    // and schedule top21 to be rotate in next schedules
-   if ( inTop21 == std::end(_gstate.last_schedule) && inTop25 == std::end(_grotation.standby_rotation) ) {
-      _grotation.last_rotation_time = picoio::current_time_point();
-      _grotation.standby_rotation.push_back( to_out );
+   if ( inTop21 == std::end(_gstate->last_schedule) && inTop25 == std::end(_grotation->standby_rotation) ) {
+      auto& grotation = _grotation.modify();
+      grotation.last_rotation_time = picoio::current_time_point();
+      grotation.standby_rotation.push_back( to_out );
 
       update_standby();
-      update_pervote_shares();
+      _ghotstate.modify().pervote_shares_changed = true;
 
       return top21_prods;
    }
 
    // top 21-25
-   std::vector<picoio::producer_authority> standby;
-   for (prod_it = std::prev( prod_it ); standby.size() < _grotation.standby_prods_to_rotate + 1 // top21 + top22-25
-         && 0 < prod_it->total_votes && prod_it->active() && prod_it != std::end(sorted_prods); ++prod_it) {
-      standby.push_back( picoio::producer_authority{
-         .producer_name = prod_it->owner,
-         .authority     = prod_it->producer_authority.has_value() ? *prod_it->producer_authority
-                                                                  : convert_to_block_signing_authority( prod_it->producer_key ) } );
+   std::vector<picoio::producer_authority> standby{ top21_prods.back() };
+   for (; standby.size() < _grotation->standby_prods_to_rotate + 1 // top21 + top22-25
+         && prod_it != std::end(ranked_prods); ++prod_it) {
+      standby.push_back( to_authority( *prod_it ) );
    }
 
    // still nothing to rotate
@@ -83,7 +85,7 @@ std::vector<picoio::producer_authority> system_contract::get_rotated_schedule()
    std::vector<picoio::producer_authority> rotation;
 
    // first go prods which were in previous rotation
-   for(const auto& prev: _grotation.standby_rotation){
+   for(const auto& prev: _grotation->standby_rotation){
       auto it = std::find_if(
          std::begin(standby), std::end(standby),
          [&prev](const auto& value) {
@@ -98,12 +100,12 @@ std::vector<picoio::producer_authority> system_contract::get_rotated_schedule()
    // then go new prods
    for(const auto& prod: standby){
       auto it = std::find_if(
-         std::begin(_grotation.standby_rotation), std::end(_grotation.standby_rotation),
+         std::begin(_grotation->standby_rotation), std::end(_grotation->standby_rotation),
          [&prod](const auto& value) {
             return value.producer_name == prod.producer_name;
          }
       ); 
-      if( it == std::end(_grotation.standby_rotation) ) {
+      if( it == std::end(_grotation->standby_rotation) ) {
          rotation.push_back(prod);
       }
    }
@@ -111,22 +113,68 @@ std::vector<picoio::producer_authority> system_contract::get_rotated_schedule()
    top21_prods.back() = rotation.front();
 
    const auto ct = picoio::current_time_point();
-   const auto next_rotation_time = _grotation.last_rotation_time + _grotation.rotation_period;
+   const auto next_rotation_time = _grotation->last_rotation_time + _grotation->rotation_period;
 
    // rotation is done only once per 4 hours
    if (next_rotation_time <= ct) {
       std::rotate( std::begin(rotation), std::begin(rotation) + 1, std::end(rotation) );
-      _grotation.last_rotation_time = ct;
-      _grotation.standby_rotation   = std::move(rotation);
+      auto& grotation = _grotation.modify();
+      grotation.last_rotation_time = ct;
+      grotation.standby_rotation   = std::move(rotation);
 
       update_standby();
-      update_pervote_shares();
+      _ghotstate.modify().pervote_shares_changed = true;
    }
    else {
-      _grotation.standby_rotation = std::move(rotation);
+      _grotation.modify().standby_rotation = std::move(rotation);
    }
 
    return top21_prods;
 }
 
+void system_contract::update_producer_ranking( const producer_info& prod ) {
+   const auto& ranked_prods = _gprodranking->producers;
+   const auto ranked_it = std::find_if( std::begin(ranked_prods), std::end(ranked_prods), [&prod]( const auto& ranked ) {
+      return ranked.owner == prod.owner;
+   } );
+   const bool rankable = prod.active() && 0 < prod.total_votes;
+   if ( ranked_it == std::end(ranked_prods) && !rankable ) {
+      return;
+   }
+   if ( ranked_it != std::end(ranked_prods) && rankable && ranked_it->total_votes == prod.total_votes ) {
+      return;
+   }
+
+   auto& ranking = _gprodranking.modify();
+   if ( ranked_it != std::end(ranked_prods) ) {
+      ranking.producers.erase( ranked_it );
+   }
+   if ( !rankable ) {
+      return;
+   }
+
+   // same order as the prototalvote index: by votes, then by owner
+   auto ranks_before = []( const ranked_producer& lhs, const ranked_producer& rhs ) {
+      return lhs.total_votes > rhs.total_votes || ( lhs.total_votes == rhs.total_votes && lhs.owner.value < rhs.owner.value );
+   };
+   ranked_producer entry{ .owner = prod.owner, .total_votes = prod.total_votes };
+
+   // producers missing from a truncated ranking all go after its last producer, so nothing is known about the place of one going after it too
+   if ( ranking.truncated && ( ranking.producers.empty() || !ranks_before( entry, ranking.producers.back() ) ) ) {
+      return;
+   }
+   ranking.producers.insert( std::upper_bound( ranking.producers.begin(), ranking.producers.end(), entry, ranks_before ), std::move(entry) );
+   if ( ranking.producers.size() > producer_ranking_state::max_ranked_producers ) {
+      ranking.producers.pop_back();
+      ranking.truncated = true;
+   }
+}
+
+const producer_ranking_state& system_contract::get_producer_ranking() {
+   if ( _gprodranking->truncated && _gprodranking->producers.size() < max_block_producers + _grotation->standby_prods_to_rotate ) {
+      _gprodranking.modify() = get_default_producer_ranking();
+   }
+   return _gprodranking.get();
+}
+
 } /// namespace picoiosystem
\ No newline at end of file
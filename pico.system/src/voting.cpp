@@ -8,6 +8,7 @@
 #include <picoio/singleton.hpp>
 
 #include <pico.system/pico.system.hpp>
+#include <pico.system/vote_weight.hpp>
 #include <pico.token/pico.token.hpp>
 
 #include <type_traits>
@@ -44,17 +45,23 @@ namespace picoiosystem {
 
       if ( prod != _producers.end() ) {
          check( ct > prod->punished_until, "can not register producer during punishment period" );
+         const bool never_claimed = prod->last_claim_time == time_point();
          _producers.modify( prod, producer, [&]( producer_info& info ){
             info.producer_key = producer_key;
             info.is_active    = true;
             info.url          = url;
             info.location     = location;
             info.producer_authority.emplace( producer_authority );
-            if ( info.last_claim_time == time_point() ) {
+            if ( never_claimed ) {
                info.last_claim_time = ct;
-               info.last_expected_produced_blocks_update = ct;
             }
          });
+         if ( never_claimed ) {
+            _producer_counters.modify( get_producer_counters( producer ), same_payer, [&]( producer_counters& c ){
+               c.last_expected_produced_blocks_update = ct;
+            });
+         }
+         update_producer_ranking( *prod );
 
          auto prod2 = _producers2.find( producer.value );
          if ( prod2 == _producers2.end() ) {
@@ -72,17 +79,21 @@ namespace picoiosystem {
             info.url             = url;
             info.location        = location;
             info.last_claim_time = ct;
-            info.last_block_time = time_point(picoio::seconds(0));
             info.top21_chosen_time = time_point(picoio::seconds(0));
             info.punished_until  = time_point(picoio::seconds(0));
-            info.last_expected_produced_blocks_update = ct;
             info.producer_authority.emplace( producer_authority );
          });
+         _producer_counters.emplace( producer, [&]( producer_counters& c ){
+            c.owner                                = producer;
+            c.last_expected_produced_blocks_update = ct;
+            c.last_block_time                      = time_point(picoio::seconds(0));
+         });
          _producers2.emplace( producer, [&]( producer_info2& info ){
             info.owner                     = producer;
             info.last_votepay_share_update = ct;
          });
       }
+      invalidate_schedule_digest();
    }
 
    void system_contract::regproducer( const name& producer, const picoio::public_key& producer_key, const std::string& url, uint16_t location ) {
@@ -111,13 +122,37 @@ namespace picoiosystem {
       _producers.modify( prod, same_payer, [&]( producer_info& info ){
          info.deactivate();
       });
+      update_producer_ranking( prod );
+      invalidate_schedule_digest();
+   }
+
+   checksum256 system_contract::get_schedule_inputs_digest() const {
+      const auto packed = picoio::pack( std::tie( _grotation.get(), _gstate->last_schedule, _gstate->last_producer_schedule_size ) );
+      return picoio::sha256( packed.data(), packed.size() );
+   }
+
+   void system_contract::invalidate_schedule_digest() {
+      if ( !_gscheddigest->producers_changed ) {
+         _gscheddigest.modify().producers_changed = true;
+      }
    }
 
    void system_contract::update_elected_producers( const block_timestamp& block_time ) {
-      _gstate.last_producer_schedule_update = block_time;
+      _ghotstate.modify().last_producer_schedule_update = block_time;
+
+      // the previous computation started from the same state and did not change it, so it would do the same again
+      const auto inputs_digest = get_schedule_inputs_digest();
+      const bool rotation_due = _grotation->last_rotation_time + _grotation->rotation_period <= current_time_point();
+      if ( !_gscheddigest->producers_changed && _gscheddigest->inputs_digest == inputs_digest && !rotation_due ) {
+         return;
+      }
+      auto commit_digest = [&]() {
+         _gscheddigest.modify() = schedule_digest_state{ .producers_changed = false, .inputs_digest = inputs_digest };
+      };
 
       auto producers = get_rotated_schedule();
-      if ( producers.size() == 0 || producers.size() < _gstate.last_producer_schedule_size ) {
+      if ( producers.size() == 0 || producers.size() < _gstate->last_producer_schedule_size ) {
+         commit_digest();
          return;
       }
 
@@ -126,20 +161,36 @@ namespace picoiosystem {
       } );
 
       if( set_proposed_producers( producers ) >= 0 ) {
-         _gstate.last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>( producers.size() );
+         _gstate.modify().last_producer_schedule_size = static_cast<decltype(_gstate->last_producer_schedule_size)>( producers.size() );
+         commit_digest();
+      } else if ( is_active_schedule( producers ) ) {
+         commit_digest();
+      } else {
+         // an earlier proposal is still waiting to become pending, the next call proposes again
+         invalidate_schedule_digest();
       }
    }
 
+   bool system_contract::is_active_schedule( const std::vector<picoio::producer_authority>& producers ) const {
+      auto active_producers = picoio::get_active_producers();
+      if ( active_producers.size() != producers.size() ) {
+         return false;
+      }
+      std::sort( active_producers.begin(), active_producers.end() );
+      return std::equal( active_producers.begin(), active_producers.end(), producers.begin(), []( const name& active, const auto& prod ) {
+         return active == prod.producer_name;
+      } );
+   }
+
    double system_contract::stake2vote( int64_t staked, time_point locked_stake_period ) const {
       check(locked_stake_period != time_point(), "vote should have mature time");
 
-      const auto weeks_to_mature = fmax( ((locked_stake_period - current_time_point())).count() / picoio::days(7).count(), 0 );
-      const auto pico_weight = 1.0 - (weeks_to_mature * 7) / (_gpicostate.stake_lock_period.count() / picoio::days(1).count());
-      
-      const double pico_weight = std::pow( 2, int64_t((current_time_point().sec_since_epoch() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7)) / double(52) );
+      const auto ct = current_time_point();
+      const int64_t weeks_to_mature   = std::max<int64_t>( (locked_stake_period - ct).count() / picoio::days(7).count(), 0 );
+      const int64_t lock_period_days  = _gpicostate->stake_lock_period.count() / picoio::days(1).count();
+      const int64_t weeks_since_epoch = (ct.sec_since_epoch() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7);
 
-      const auto vote_weight = double(staked) * pico_weight * pico_weight;
-      check( vote_weight >= 0.0, "vote weight cannot be negative" );
+      const auto vote_weight = get_vote_weight( staked, weeks_to_mature, lock_period_days, weeks_since_epoch );
 
       return vote_weight;
    }
@@ -161,7 +212,7 @@ namespace picoiosystem {
          check( producers.size() == 0, "cannot vote for producers and proxy at same time" );
          check( voter_name != proxy, "cannot proxy to self" );
       } else {
-         check( producers.size() <= 30, "attempt to vote for too many producers" );
+         check( producers.size() <= producer_vote_deltas::max_producer_votes, "attempt to vote for too many producers" );
          for( size_t i = 1; i < producers.size(); ++i ) {
             check( producers[i-1] < producers[i], "producer votes must be unique and sorted" );
          }
@@ -170,6 +221,7 @@ namespace picoiosystem {
       auto voter = _voters.find( voter_name.value );
       check( voter != _voters.end(), "user must stake before they can vote" ); /// staking creates voter object
       check( !proxy || !voter->is_proxy, "account registered as a proxy is not allowed to use a proxy" );
+      const auto stake_itr = get_voter_stake( voter_name );
 
 
       /**
@@ -178,23 +230,24 @@ namespace picoiosystem {
        * their first vote and should consider their stake activated.
        */
       if( voter->last_vote_weight <= 0.0 ) {
-         _gstate.total_activated_stake += voter->staked;
-         if( _gstate.total_activated_stake >= min_activated_stake && _gstate.thresh_activated_stake_time == time_point() ) {
-            _gstate.thresh_activated_stake_time = current_time_point();
+         _ghotstate.modify().total_activated_stake += stake_itr->staked;
+         if( _ghotstate->total_activated_stake >= min_activated_stake && _gstate->thresh_activated_stake_time == time_point() ) {
+            _gstate.modify().thresh_activated_stake_time = current_time_point();
          }
       }
 
       double new_vote_weight = 0;
       
       if(producers.size()) {
-         new_vote_weight = stake2vote( voter->staked, voter->stake_lock_time ) / producers.size();
+         new_vote_weight = stake2vote( stake_itr->staked, stake_itr->stake_lock_time ) / producers.size();
       }
       
       if( voter->is_proxy ) {
          new_vote_weight += voter->proxied_vote_weight;
       }
 
-      std::map<name, std::pair<double, bool /*new*/> > producer_deltas;
+      // deltas of the voter and of the proxies it leaves or joins are coalesced, so each producer is modified once
+      producer_vote_deltas producer_deltas;
       if ( voter->last_vote_weight > 0 ) {
          if( voter->proxy ) {
             auto old_proxy = _voters.find( voter->proxy.value );
@@ -202,13 +255,9 @@ namespace picoiosystem {
             _voters.modify( old_proxy, same_payer, [&]( auto& vp ) {
                   vp.proxied_vote_weight -= voter->last_vote_weight;
                });
-            propagate_weight_change( *old_proxy );
+            propagate_weight_change( *old_proxy, producer_deltas );
          } else {
-            for( const auto& p : voter->producers ) {
-               auto& d = producer_deltas[p];
-               d.first -= voter->last_vote_weight;
-               d.second = false;
-            }
+            producer_deltas.add( voter->producers, -voter->last_vote_weight, false, false );
          }
       }
 
@@ -220,45 +269,25 @@ namespace picoiosystem {
             _voters.modify( new_proxy, same_payer, [&]( auto& vp ) {
                   vp.proxied_vote_weight += new_vote_weight;
                });
-            propagate_weight_change( *new_proxy );
+            propagate_weight_change( *new_proxy, producer_deltas );
          }
       } else {
          if( new_vote_weight >= 0 ) {
-            for( const auto& p : producers ) {
-               auto& d = producer_deltas[p];
-               d.first += new_vote_weight;
-               d.second = true;
-            }
+            producer_deltas.add( producers, new_vote_weight, true, false );
          }
       }
 
-      for( const auto& pd : producer_deltas ) {
-         auto pitr = _producers.find( pd.first.value );
-         if( pitr != _producers.end() ) {
-            if( voting && !pitr->active() && pd.second.second /* from new set */ ) {
-               check( false, ( "producer " + pitr->owner.to_string() + " is not currently registered" ).data() );
-            }
-            _producers.modify( pitr, same_payer, [&]( auto& p ) {
-               p.total_votes += pd.second.first;
-               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
-                  p.total_votes = 0;
-               }
-               _gstate.total_producer_vote_weight += pd.second.first;
-            });
-         } else {
-            if( pd.second.second ) {
-               check( false, ( "producer " + pd.first.to_string() + " is not registered" ).data() );
-            }
-         }
-      }
-      update_pervote_shares();
+      apply_producer_vote_deltas( producer_deltas, voting );
 
       _voters.modify( voter, same_payer, [&]( auto& av ) {
          av.last_vote_weight = new_vote_weight;
          av.producers = producers;
          av.proxy     = proxy;
-         av.last_reassertion_time = current_time_point();
       });
+      _voter_stakes.modify( stake_itr, same_payer, [&]( auto& s ) {
+         s.last_reassertion_time = current_time_point();
+      });
+      update_guardian_stake( *stake_itr );
    }
 
    void system_contract::regproxy( const name& proxy, bool isproxy ) {
@@ -271,7 +300,9 @@ namespace picoiosystem {
          _voters.modify( pitr, same_payer, [&]( auto& p ) {
                p.is_proxy = isproxy;
             });
-         propagate_weight_change( *pitr );
+         producer_vote_deltas producer_deltas;
+         propagate_weight_change( *pitr, producer_deltas );
+         apply_producer_vote_deltas( producer_deltas, false );
       } else {
          _voters.emplace( proxy, [&]( auto& p ) {
                p.owner  = proxy;
@@ -280,44 +311,72 @@ namespace picoiosystem {
       }
    }
 
-   void system_contract::propagate_weight_change( const voter_info& voter ) {
-      check( !voter.proxy || !voter.is_proxy, "account registered as a proxy is not allowed to use a proxy" );
-      
-      double new_weight = 0;
-      
-      if(voter.producers.size()) {
-         new_weight = stake2vote( voter.staked, voter.stake_lock_time ) / voter.producers.size();
-      }
-      if ( voter.is_proxy ) {
-         new_weight += voter.proxied_vote_weight;
+   void system_contract::propagate_weight_change( const voter_info& voter, producer_vote_deltas& deltas ) {
+      // weight change is propagated up the proxy chain iteratively, producer deltas are only collected here
+      for ( const voter_info* current = &voter; current != nullptr; ) {
+         check( !current->proxy || !current->is_proxy, "account registered as a proxy is not allowed to use a proxy" );
+
+         double new_weight = 0;
+
+         if(current->producers.size()) {
+            const auto stake_itr = get_voter_stake( current->owner );
+            new_weight = stake2vote( stake_itr->staked, stake_itr->stake_lock_time ) / current->producers.size();
+         }
+         if ( current->is_proxy ) {
+            new_weight += current->proxied_vote_weight;
+         }
+
+         const voter_info* next = nullptr;
+         /// don't propagate small changes (1 ~= epsilon)
+         if ( fabs( new_weight - current->last_vote_weight ) > 1 )  {
+            if ( current->proxy ) {
+               const auto& proxy = _voters.get( current->proxy.value, "proxy not found" ); //data corruption
+               _voters.modify( proxy, same_payer, [&]( auto& p ) {
+                     p.proxied_vote_weight += new_weight - current->last_vote_weight;
+                  }
+               );
+               next = &proxy;
+            } else {
+               deltas.add( current->producers, new_weight - current->last_vote_weight, false, true );
+            }
+         }
+
+         _voters.modify( *current, same_payer, [&]( auto& v ) {
+               v.last_vote_weight = new_weight;
+            }
+         );
+         current = next;
       }
+   }
 
-      /// don't propagate small changes (1 ~= epsilon)
-      if ( fabs( new_weight - voter.last_vote_weight ) > 1 )  {
-         if ( voter.proxy ) {
-            auto& proxy = _voters.get( voter.proxy.value, "proxy not found" ); //data corruption
-            _voters.modify( proxy, same_payer, [&]( auto& p ) {
-                  p.proxied_vote_weight += new_weight - voter.last_vote_weight;
+   void system_contract::apply_producer_vote_deltas( const producer_vote_deltas& deltas, bool voting ) {
+      for( const auto& pd : deltas ) {
+         auto pitr = _producers.find( pd.producer.value );
+         if( pitr != _producers.end() ) {
+            if( voting && !pitr->active() && pd.from_new_set ) {
+               check( false, ( "producer " + pitr->owner.to_string() + " is not currently registered" ).data() );
+            }
+            _producers.modify( pitr, same_payer, [&]( auto& p ) {
+               p.total_votes += pd.weight;
+               // floating point arithmetics can give small negative numbers,
+               // only deltas of the vote itself are clamped, proxied weight changes never were
+               if ( pd.direct && p.total_votes < 0 ) {
+                  p.total_votes = 0;
                }
-            );
-            propagate_weight_change( proxy );
+            });
+            update_producer_ranking( *pitr );
+            _ghotstate.modify().total_producer_vote_weight += pd.weight;
          } else {
-            auto delta = new_weight - voter.last_vote_weight;
-            for ( auto acnt : voter.producers ) {
-               auto& prod = _producers.get( acnt.value, "producer not found" ); //data corruption
-               const double init_total_votes = prod.total_votes;
-               _producers.modify( prod, same_payer, [&]( auto& p ) {
-                  p.total_votes += delta;
-                  _gstate.total_producer_vote_weight += delta;
-               });
+            if( pd.from_new_set ) {
+               check( false, ( "producer " + pd.producer.to_string() + " is not registered" ).data() );
             }
-            update_pervote_shares();
+            check( !pd.required, "producer not found" ); //data corruption
          }
       }
 
-      _voters.modify( voter, same_payer, [&]( auto& v ) {
-            v.last_vote_weight = new_weight;
-         }
-      );
+      if ( !deltas.empty() ) {
+         _ghotstate.modify().pervote_shares_changed = true;
+         invalidate_schedule_digest();
+      }
    }
 } /// namespace picoiosystem
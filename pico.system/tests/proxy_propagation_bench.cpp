@@ -0,0 +1,311 @@
+#include <pico.system/producer_vote_deltas.hpp>
+
+#include <picoio/picoio.hpp>
+
+#include <host_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Proxy weight propagation over large proxy fan-in trees: the recursive propagation `update_votes` used before,
+ * which modifies every producer of a proxy at each propagation and recomputes per-vote shares each time,
+ * against the iterative propagation that collects producer deltas in `producer_vote_deltas` and modifies
+ * every producer once.
+ *
+ * The system contract itself does not build natively, so both propagations are reproduced here over host
+ * voters and producers tables with the vote weight reduced to the stake. Table accesses are counted
+ * by the host multi_index, both models have to end with the same producer votes.
+ */
+
+using namespace picoio;
+using picoiosystem::producer_vote_deltas;
+
+namespace {
+
+   struct voter_row {
+      name                owner;
+      name                proxy;
+      std::vector<name>   producers;
+      int64_t             staked = 0;
+      double              last_vote_weight = 0;
+      double              proxied_vote_weight = 0;
+      bool                is_proxy = false;
+
+      uint64_t primary_key()const { return owner.value; }
+   };
+
+   struct producer_row {
+      name     owner;
+      double   total_votes = 0;
+
+      uint64_t primary_key()const { return owner.value; }
+   };
+
+   typedef multi_index<"voters"_n, voter_row>       voters_table;
+   typedef multi_index<"producers"_n, producer_row> producers_table;
+
+   double vote_weight( const voter_row& voter ) {
+      double weight = double(voter.staked);
+      if ( voter.is_proxy ) {
+         weight += voter.proxied_vote_weight;
+      }
+      return weight;
+   }
+
+   /**
+    * Recursive propagation as `propagate_weight_change` did before the iterative engine.
+    */
+   struct recursive_model {
+      voters_table    voters;
+      producers_table producers;
+      uint64_t        share_recomputations = 0;
+
+      explicit recursive_model( name code ) : voters( code, code.value ), producers( code, code.value ) {}
+
+      void propagate_weight_change( const voter_row& voter ) {
+         const double new_weight = vote_weight( voter );
+         if ( std::fabs( new_weight - voter.last_vote_weight ) > 1 ) {
+            if ( voter.proxy ) {
+               const auto& proxy = voters.get( voter.proxy.value, "proxy not found" );
+               voters.modify( proxy, same_payer, [&]( auto& p ) {
+                  p.proxied_vote_weight += new_weight - voter.last_vote_weight;
+               });
+               propagate_weight_change( proxy );
+            } else {
+               const auto delta = new_weight - voter.last_vote_weight;
+               for ( const auto& acnt : voter.producers ) {
+                  const auto& prod = producers.get( acnt.value, "producer not found" );
+                  producers.modify( prod, same_payer, [&]( auto& p ) {
+                     p.total_votes += delta;
+                  });
+               }
+               ++share_recomputations;
+            }
+         }
+         voters.modify( voter, same_payer, [&]( auto& v ) {
+            v.last_vote_weight = new_weight;
+         });
+      }
+
+      void vote_for_proxy( name voter_name, name proxy ) {
+         const auto& voter = voters.get( voter_name.value );
+         const double new_vote_weight = vote_weight( voter );
+         if ( voter.last_vote_weight > 0 && voter.proxy ) {
+            const auto& old_proxy = voters.get( voter.proxy.value );
+            voters.modify( old_proxy, same_payer, [&]( auto& vp ) {
+               vp.proxied_vote_weight -= voter.last_vote_weight;
+            });
+            propagate_weight_change( old_proxy );
+         }
+         const auto& new_proxy = voters.get( proxy.value );
+         voters.modify( new_proxy, same_payer, [&]( auto& vp ) {
+            vp.proxied_vote_weight += new_vote_weight;
+         });
+         propagate_weight_change( new_proxy );
+         ++share_recomputations;
+
+         voters.modify( voter, same_payer, [&]( auto& av ) {
+            av.last_vote_weight = new_vote_weight;
+            av.proxy = proxy;
+         });
+      }
+   };
+
+   /**
+    * Iterative propagation as `propagate_weight_change` and `apply_producer_vote_deltas` do now.
+    */
+   struct iterative_model {
+      voters_table    voters;
+      producers_table producers;
+      uint64_t        share_recomputations = 0;
+
+      explicit iterative_model( name code ) : voters( code, code.value ), producers( code, code.value ) {}
+
+      void propagate_weight_change( const voter_row& voter, producer_vote_deltas& deltas ) {
+         for ( const voter_row* current = &voter; current != nullptr; ) {
+            const double new_weight = vote_weight( *current );
+            const voter_row* next = nullptr;
+            if ( std::fabs( new_weight - current->last_vote_weight ) > 1 ) {
+               if ( current->proxy ) {
+                  const auto& proxy = voters.get( current->proxy.value, "proxy not found" );
+                  voters.modify( proxy, same_payer, [&]( auto& p ) {
+                     p.proxied_vote_weight += new_weight - current->last_vote_weight;
+                  });
+                  next = &proxy;
+               } else {
+                  deltas.add( current->producers, new_weight - current->last_vote_weight, false, true );
+               }
+            }
+            voters.modify( *current, same_payer, [&]( auto& v ) {
+               v.last_vote_weight = new_weight;
+            });
+            current = next;
+         }
+      }
+
+      void apply_producer_vote_deltas( const producer_vote_deltas& deltas ) {
+         for ( const auto& pd : deltas ) {
+            auto pitr = producers.find( pd.producer.value );
+            check( pitr != producers.end(), "producer not found" );
+            producers.modify( pitr, same_payer, [&]( auto& p ) {
+               p.total_votes += pd.weight;
+            });
+         }
+         if ( !deltas.empty() ) {
+            ++share_recomputations;
+         }
+      }
+
+      void vote_for_proxy( name voter_name, name proxy ) {
+         const auto& voter = voters.get( voter_name.value );
+         const double new_vote_weight = vote_weight( voter );
+         producer_vote_deltas deltas;
+         if ( voter.last_vote_weight > 0 && voter.proxy ) {
+            const auto& old_proxy = voters.get( voter.proxy.value );
+            voters.modify( old_proxy, same_payer, [&]( auto& vp ) {
+               vp.proxied_vote_weight -= voter.last_vote_weight;
+            });
+            propagate_weight_change( old_proxy, deltas );
+         }
+         const auto& new_proxy = voters.get( proxy.value );
+         voters.modify( new_proxy, same_payer, [&]( auto& vp ) {
+            vp.proxied_vote_weight += new_vote_weight;
+         });
+         propagate_weight_change( new_proxy, deltas );
+         apply_producer_vote_deltas( deltas );
+
+         voters.modify( voter, same_payer, [&]( auto& av ) {
+            av.last_vote_weight = new_vote_weight;
+            av.proxy = proxy;
+         });
+      }
+   };
+
+   name account( const char* prefix, uint32_t i ) {
+      std::string str( prefix );
+      for ( int k = 0; k < 4; ++k, i /= 26 ) {
+         str += char( 'a' + i % 26 );
+      }
+      return name( str );
+   }
+
+   std::vector<name> producer_names( uint32_t first, uint32_t count ) {
+      std::vector<name> result;
+      for ( uint32_t i = first; i < first + count; ++i ) {
+         result.push_back( account( "prod", i ) );
+      }
+      std::sort( result.begin(), result.end() );
+      return result;
+   }
+
+   const name proxy_a = "proxya"_n;
+   const name proxy_b = "proxyb"_n;
+
+   // two proxies voting for 30 producers each, 20 of them shared, with `delegators` members voting through proxy A
+   template <typename Model>
+   void populate( Model& model, uint32_t delegators ) {
+      for ( const auto& p : producer_names( 0, 40 ) ) {
+         model.producers.emplace( p, [&]( auto& row ) { row.owner = p; } );
+      }
+      model.voters.emplace( proxy_a, [&]( auto& v ) {
+         v.owner = proxy_a; v.is_proxy = true; v.producers = producer_names( 0, 30 );
+      });
+      model.voters.emplace( proxy_b, [&]( auto& v ) {
+         v.owner = proxy_b; v.is_proxy = true; v.producers = producer_names( 10, 30 );
+      });
+      for ( uint32_t i = 0; i < delegators; ++i ) {
+         const auto owner = account( "member", i );
+         model.voters.emplace( owner, [&]( auto& v ) { v.owner = owner; v.staked = 10000000 + i; } );
+         model.vote_for_proxy( owner, proxy_a );
+      }
+   }
+
+   struct run_result {
+      uint64_t producer_reads   = 0;
+      uint64_t producer_updates = 0;
+      uint64_t voter_updates    = 0;
+      uint64_t share_recomputations = 0;
+      double   host_ns          = 0;
+   };
+
+   // every member changes its stake and votes again, either for the same proxy or for the other one
+   template <typename Model>
+   run_result run( Model& model, uint32_t delegators, name to_proxy ) {
+      auto& chain = host::chain();
+      chain.reset_counters();
+      model.share_recomputations = 0;
+
+      const auto start = std::chrono::steady_clock::now();
+      for ( uint32_t i = 0; i < delegators; ++i ) {
+         const auto owner = account( "member", i );
+         model.voters.modify( model.voters.get( owner.value ), same_payer, [&]( auto& v ) { v.staked += 5000000; } );
+         model.vote_for_proxy( owner, to_proxy );
+      }
+      run_result result;
+      result.host_ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / delegators;
+
+      result.producer_reads       = chain.tables["producers"_n].reads;
+      result.producer_updates     = chain.tables["producers"_n].updates;
+      result.voter_updates        = chain.tables["voters"_n].updates;
+      result.share_recomputations = model.share_recomputations;
+      return result;
+   }
+
+   void print( const char* scenario, const char* label, const run_result& r, uint32_t n ) {
+      std::printf( "%-16s %-10s %12.1f %12.1f %12.1f %12.2f %10.1f\n", scenario, label,
+                   double(r.producer_reads) / n, double(r.producer_updates) / n, double(r.voter_updates) / n,
+                   double(r.share_recomputations) / n, r.host_ns );
+   }
+
+   void check_same_votes( recursive_model& recursive, iterative_model& iterative, const char* scenario ) {
+      for ( const auto& p : producer_names( 0, 40 ) ) {
+         const double expected = recursive.producers.get( p.value ).total_votes;
+         const double actual   = iterative.producers.get( p.value ).total_votes;
+         HOST_CHECK( std::fabs( expected - actual ) <= 1e-9 * std::fabs( expected ) + 1e-6,
+                     "%s: votes of %s %.17g vs %.17g", scenario, p.to_string().c_str(), actual, expected );
+      }
+   }
+
+} /// namespace
+
+int main( int argc, char** argv ) {
+   const uint32_t delegators = argc > 1 ? std::stoul( argv[1] ) : 5000;
+
+   recursive_model recursive( "recursive"_n );
+   iterative_model iterative( "iterative"_n );
+   populate( recursive, delegators );
+   populate( iterative, delegators );
+   check_same_votes( recursive, iterative, "setup" );
+
+   std::printf( "%u members of a proxy voting for 30 producers, per member action\n\n", delegators );
+   std::printf( "%-16s %-10s %12s %12s %12s %12s %10s\n", "scenario", "engine", "prod reads", "prod updates",
+                "voter updates", "share recomp", "host ns" );
+
+   const auto revote_recursive = run( recursive, delegators, proxy_a );
+   const auto revote_iterative = run( iterative, delegators, proxy_a );
+   print( "restake, revote", "recursive", revote_recursive, delegators );
+   print( "restake, revote", "iterative", revote_iterative, delegators );
+   check_same_votes( recursive, iterative, "revote" );
+
+   const auto switch_recursive = run( recursive, delegators, proxy_b );
+   const auto switch_iterative = run( iterative, delegators, proxy_b );
+   print( "switch proxy", "recursive", switch_recursive, delegators );
+   print( "switch proxy", "iterative", switch_iterative, delegators );
+   check_same_votes( recursive, iterative, "switch" );
+
+   // both propagations of a revote touch the same 30 producers, a switch touches the union of both proxies
+   HOST_CHECK( revote_iterative.producer_updates == 30ull * delegators, "revote producer updates %llu",
+               (unsigned long long)revote_iterative.producer_updates );
+   HOST_CHECK( revote_recursive.producer_updates == 60ull * delegators, "baseline revote producer updates %llu",
+               (unsigned long long)revote_recursive.producer_updates );
+   HOST_CHECK( switch_iterative.producer_updates == 40ull * delegators, "switch producer updates %llu",
+               (unsigned long long)switch_iterative.producer_updates );
+
+   return host_test::result();
+}
@@ -0,0 +1,210 @@
+#include <pico.system/rex_math.hpp>
+
+#include <host_test.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+
+/**
+ * Test vectors and a randomized harness for the integer Bancor and REX pool kernel.
+ *
+ * `legacy_bancor_output` is the double-precision formula the kernel replaced, vectors record its output
+ * next to the exact one so the rounding difference between them stays documented.
+ */
+
+using namespace picoiosystem;
+
+namespace {
+
+   constexpr int64_t max_amount = ( 1ll << 62 ) - 1;
+   constexpr int64_t undefined  = -1; // legacy formula divides zero by zero
+
+   int64_t legacy_bancor_output( int64_t inp_reserve, int64_t out_reserve, int64_t inp ) {
+      const double ib = inp_reserve;
+      const double ob = out_reserve;
+      const double in = inp;
+
+      int64_t out = int64_t( (in * ob) / (ib + in) );
+
+      if ( out < 0 ) out = 0;
+
+      return out;
+   }
+
+   struct bancor_vector {
+      int64_t inp_reserve;
+      int64_t out_reserve;
+      int64_t inp;
+      int64_t expected;
+      int64_t legacy;
+   };
+
+   const bancor_vector bancor_vectors[] = {
+      { 0, 0, 0, 0, undefined },
+      { 0, 1, 1, 1, 1 },
+      { 1, 0, 1, 0, 0 },
+      { 1, 1, 0, 0, 0 },
+      { 1, 1, 1, 0, 0 },
+      { 0, 10000, 1, 10000, 10000 },
+      { 10000, 10000, 1, 0, 0 },
+      { 10000, 10000, 10000, 5000, 5000 },
+      { 40000000000, 25000000000, 1000000, 624984, 624984 },
+      { 10000000000000, 10000000000000, 1000000000, 999900009, 999900009 },
+      { 123456789012, 987654321098, 55555, 444439, 444439 },
+      { 99999999999999, 1, 99999999999999, 0, 0 },
+      // double rounding of the legacy formula shows up past 2^53
+      { 9007199254740992, 9007199254740992, 1, 0, 1 },
+      { 9007199254740993, 9007199254740995, 7, 6, 6 },
+      { 3, 9007199254740993, 9007199254740993, 9007199254740990, 9007199254740988 },
+      { 1, max_amount, 1, 2305843009213693951, 2305843009213693952 },
+      { max_amount, 1, max_amount, 0, 0 },
+      { max_amount, max_amount, max_amount, 2305843009213693951, 2305843009213693952 },
+      { max_amount, max_amount, 1, 0, 1 },
+      { 1, max_amount, max_amount, 4611686018427387902, 4611686018427387904 },
+      // invalid inputs produce no output, the legacy formula could pay out of a negative reserve
+      { 5, -1, 3, 0, 0 },
+      { -1, 5, 3, 0, 7 },
+      { 7, 7, -5, 0, 0 },
+      { 503, 2943980288711, 12972, 2834086256412, 2834086256412 },
+      { 1448502350020927634, 785867954, 634522496, 0, 0 },
+      { 952248094, 25705, 117864, 3, 3 },
+      { 11412234911529, 15783234156, 1949933081003757, 15691398223, 15691398223 },
+      { 3740448938665957523, 11077, 13121, 0, 0 },
+      { 161999146434424, 5161990204, 15362633134025, 447118662, 447118662 },
+      { 277909448563028, 11735, 277868, 0, 0 },
+      { 0, 14793513, 457034887823692, 14793513, 14793513 },
+      { 18665566498, 36622051308, 5403688491474742, 36621924807, 36621924807 },
+      { 38832101509368, 72, 1219545263, 0, 0 },
+      { 167406849412405241, 2937473973, 1786318263717258, 31013447, 31013447 },
+      { 388, 10604, 7687160963925, 10603, 10603 },
+   };
+
+   struct scale_vector {
+      int64_t amount;
+      int64_t numerator;
+      int64_t denominator;
+      int64_t expected;
+   };
+
+   const scale_vector scale_vectors[] = {
+      { 0, 0, 1, 0 },
+      { 0, max_amount, 1, 0 },
+      { 10, 1000, 3, 3333 },
+      { 1000, 3, 10000, 0 },
+      { 1, max_amount, max_amount, 1 },
+      { max_amount, 1, max_amount, 1 },
+      { max_amount, max_amount, max_amount, max_amount },
+      { max_amount - 1, max_amount, max_amount, max_amount - 1 },
+      { 300000, 10000000000000, 3, 1000000000000000000 },
+      { 123456789, 987654321, 1000000007, 121932630 },
+   };
+
+   void test_bancor_vectors() {
+      for ( const auto& v : bancor_vectors ) {
+         const auto out = get_bancor_output( v.inp_reserve, v.out_reserve, v.inp );
+         HOST_CHECK( out == v.expected, "bancor(%lld, %lld, %lld) = %lld, expected %lld", (long long)v.inp_reserve,
+                     (long long)v.out_reserve, (long long)v.inp, (long long)out, (long long)v.expected );
+         if ( v.legacy != undefined ) {
+            const auto legacy = legacy_bancor_output( v.inp_reserve, v.out_reserve, v.inp );
+            HOST_CHECK( legacy == v.legacy, "legacy bancor(%lld, %lld, %lld) = %lld, recorded %lld", (long long)v.inp_reserve,
+                        (long long)v.out_reserve, (long long)v.inp, (long long)legacy, (long long)v.legacy );
+         }
+      }
+   }
+
+   void test_scale_vectors() {
+      for ( const auto& v : scale_vectors ) {
+         const auto out = scale_pool_amount( v.amount, v.numerator, v.denominator );
+         HOST_CHECK( out == v.expected, "scale(%lld, %lld, %lld) = %lld, expected %lld", (long long)v.amount,
+                     (long long)v.numerator, (long long)v.denominator, (long long)out, (long long)v.expected );
+      }
+      HOST_CHECK( rex_to_core( 10, 1000, 3 ) == 3333, "rex_to_core scales by lendable over rex" );
+      HOST_CHECK( core_to_rex( 10, 3, 1000 ) == 3333, "core_to_rex scales by rex over lendable" );
+
+      HOST_CHECK_THROWS( scale_pool_amount( 1, 1, 0 ), "zero denominator" );
+      HOST_CHECK_THROWS( scale_pool_amount( -1, 1, 1 ), "negative amount" );
+      HOST_CHECK_THROWS( scale_pool_amount( 1, -1, 1 ), "negative numerator" );
+      HOST_CHECK_THROWS( scale_pool_amount( max_amount, max_amount, 1 ), "overflow" );
+      HOST_CHECK_THROWS( rex_to_core( 1, 1, 0 ), "empty rex pool" );
+      HOST_CHECK_THROWS( core_to_rex( 1, 0, 1 ), "empty lendable pool" );
+   }
+
+   int64_t random_amount( std::mt19937_64& rng ) {
+      return int64_t( rng() >> ( 2 + rng() % 62 ) );
+   }
+
+   void fuzz_bancor( std::mt19937_64& rng, uint64_t iterations ) {
+      uint64_t legacy_differences = 0;
+      for ( uint64_t i = 0; i < iterations; ++i ) {
+         const int64_t ib  = random_amount( rng );
+         const int64_t ob  = random_amount( rng );
+         const int64_t inp = random_amount( rng );
+         const int64_t out = get_bancor_output( ib, ob, inp );
+         if ( inp == 0 || ob == 0 ) {
+            HOST_CHECK( out == 0, "no output without input or reserve" );
+            continue;
+         }
+
+         // rounded down: out * (ib + inp) <= inp * ob < (out + 1) * (ib + inp)
+         const uint128_t product = uint128_t(inp) * uint64_t(ob);
+         const uint128_t divisor = uint128_t(ib) + uint64_t(inp);
+         HOST_CHECK( uint128_t(out) * divisor <= product && product < uint128_t(out + 1) * divisor,
+                     "bancor(%lld, %lld, %lld) = %lld is not rounded down", (long long)ib, (long long)ob, (long long)inp, (long long)out );
+         HOST_CHECK( out <= ob && ( ib == 0 || out < ob ), "output never drains the reserve" );
+         if ( inp < max_amount ) {
+            HOST_CHECK( out <= get_bancor_output( ib, ob, inp + 1 ), "output grows with input" );
+         }
+         if ( ib > 0 ) {
+            HOST_CHECK( out >= get_bancor_output( ib + 1, ob, inp ), "output shrinks with input reserve" );
+         }
+
+         // the legacy formula is off by its double rounding only
+         const int64_t legacy = legacy_bancor_output( ib, ob, inp );
+         const double  bound  = 1.0 + std::ldexp( double(out), -50 );
+         HOST_CHECK( std::fabs( double(legacy) - double(out) ) <= bound, "bancor(%lld, %lld, %lld) = %lld, legacy %lld",
+                     (long long)ib, (long long)ob, (long long)inp, (long long)out, (long long)legacy );
+         legacy_differences += legacy != out;
+      }
+      std::printf( "bancor: %llu of %llu random conversions differ from the legacy formula, all within its double rounding\n",
+                   (unsigned long long)legacy_differences, (unsigned long long)iterations );
+   }
+
+   void fuzz_pool( std::mt19937_64& rng, uint64_t iterations ) {
+      for ( uint64_t i = 0; i < iterations; ++i ) {
+         const int64_t total_lendable = random_amount( rng ) + 1;
+         const int64_t total_rex      = random_amount( rng ) + 1;
+         const int64_t rex            = random_amount( rng ) % total_rex;
+
+         const uint128_t product = uint128_t(rex) * uint64_t(total_lendable);
+         if ( product / uint64_t(total_rex) > uint128_t(max_amount) ) {
+            HOST_CHECK_THROWS( rex_to_core( rex, total_lendable, total_rex ), "overflow is rejected" );
+            continue;
+         }
+         const int64_t core = rex_to_core( rex, total_lendable, total_rex );
+         HOST_CHECK( uint128_t(core) * uint64_t(total_rex) <= product && product < uint128_t(core + 1) * uint64_t(total_rex),
+                     "rex_to_core(%lld, %lld, %lld) = %lld is not rounded down", (long long)rex,
+                     (long long)total_lendable, (long long)total_rex, (long long)core );
+
+         // converting back never yields more rex than was sold
+         if ( uint128_t(core) * uint64_t(total_rex) / uint64_t(total_lendable) <= uint128_t(max_amount) ) {
+            HOST_CHECK( core_to_rex( core, total_lendable, total_rex ) <= rex, "round trip creates rex" );
+         }
+      }
+   }
+
+} /// namespace
+
+int main( int argc, char** argv ) {
+   const uint64_t iterations = argc > 1 ? std::stoull( argv[1] ) : 1000000;
+   const uint64_t seed       = argc > 2 ? std::stoull( argv[2] ) : 18;
+
+   test_bancor_vectors();
+   test_scale_vectors();
+
+   std::mt19937_64 rng( seed );
+   fuzz_bancor( rng, iterations );
+   fuzz_pool( rng, iterations );
+   return host_test::result();
+}
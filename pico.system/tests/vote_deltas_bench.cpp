@@ -0,0 +1,129 @@
+#include <pico.system/producer_vote_deltas.hpp>
+
+#include <host_test.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Compares the fixed-capacity producer vote delta merge with the `std::map` merge `update_votes` used before,
+ * for votes of 1, 21 and 30 producers. Every case merges the previous vote of a voter with a new vote that
+ * keeps two thirds of the producers, both kernels have to give the same deltas.
+ */
+
+using picoio::name;
+using picoiosystem::producer_vote_deltas;
+
+namespace {
+
+   using map_deltas = std::map<name, std::pair<double, bool /*new*/>>;
+
+   // merge of the old and the new vote as `update_votes` did before the fixed-capacity kernel
+   map_deltas merge_with_map( const std::vector<name>& old_producers, double old_weight,
+                              const std::vector<name>& new_producers, double new_weight ) {
+      map_deltas producer_deltas;
+      for ( const auto& p : old_producers ) {
+         auto& d = producer_deltas[p];
+         d.first -= old_weight;
+         d.second = false;
+      }
+      for ( const auto& p : new_producers ) {
+         auto& d = producer_deltas[p];
+         d.first += new_weight;
+         d.second = true;
+      }
+      return producer_deltas;
+   }
+
+   producer_vote_deltas merge_with_kernel( const std::vector<name>& old_producers, double old_weight,
+                                           const std::vector<name>& new_producers, double new_weight ) {
+      producer_vote_deltas producer_deltas;
+      producer_deltas.add( old_producers, -old_weight, false, false );
+      producer_deltas.add( new_producers, new_weight, true, false );
+      return producer_deltas;
+   }
+
+   name producer( uint32_t i ) {
+      std::string str = "prod";
+      for ( int k = 0; k < 4; ++k, i /= 26 ) {
+         str += char( 'a' + i % 26 );
+      }
+      return name( str );
+   }
+
+   std::vector<name> producers( uint32_t first, uint32_t count ) {
+      std::vector<name> result;
+      for ( uint32_t i = first; i < first + count; ++i ) {
+         result.push_back( producer( i ) );
+      }
+      std::sort( result.begin(), result.end() );
+      return result;
+   }
+
+   template <typename Merge>
+   double ns_per_merge( uint32_t iterations, Merge&& merge ) {
+      double sink = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for ( uint32_t i = 0; i < iterations; ++i ) {
+         sink += merge( i );
+      }
+      const auto elapsed = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+      // keeps the merges from being optimized away
+      if ( sink == -1 ) {
+         std::printf( "%g\n", sink );
+      }
+      return elapsed / iterations;
+   }
+
+   void run( uint32_t votes, uint32_t iterations ) {
+      const auto old_producers = producers( 0, votes );
+      const auto new_producers = producers( votes / 3, votes );
+      const double old_weight = 1e12 / votes;
+      const double new_weight = 1.5e12 / votes;
+
+      const auto expected = merge_with_map( old_producers, old_weight, new_producers, new_weight );
+      const auto actual   = merge_with_kernel( old_producers, old_weight, new_producers, new_weight );
+      auto it = expected.begin();
+      for ( const auto& d : actual ) {
+         HOST_CHECK( it != expected.end() && it->first == d.producer, "%u votes: producer order", votes );
+         if ( it == expected.end() ) {
+            break;
+         }
+         HOST_CHECK( it->second.first == d.weight && it->second.second == d.from_new_set,
+                     "%u votes: delta of %s", votes, d.producer.to_string().c_str() );
+         ++it;
+      }
+      HOST_CHECK( it == expected.end(), "%u votes: number of deltas", votes );
+
+      const double map_ns = ns_per_merge( iterations, [&]( uint32_t i ) {
+         return merge_with_map( old_producers, old_weight + i, new_producers, new_weight ).begin()->second.first;
+      } );
+      const double kernel_ns = ns_per_merge( iterations, [&]( uint32_t i ) {
+         return merge_with_kernel( old_producers, old_weight + i, new_producers, new_weight ).begin()->weight;
+      } );
+      std::printf( "%5u %8zu %12.1f %12.1f %8.2fx\n", votes, expected.size(), map_ns, kernel_ns, map_ns / kernel_ns );
+   }
+
+} /// namespace
+
+int main( int argc, char** argv ) {
+   const uint32_t iterations = argc > 1 ? std::stoul( argv[1] ) : 100000;
+
+   std::printf( "%5s %8s %12s %12s %9s\n", "votes", "deltas", "map ns", "kernel ns", "speedup" );
+   for ( const uint32_t votes : { 1u, 21u, 30u } ) {
+      run( votes, iterations );
+   }
+
+   HOST_CHECK_THROWS( [] {
+      producer_vote_deltas deltas;
+      deltas.add( producers( 0, 30 ), 1, false, false );
+      deltas.add( producers( 30, 30 ), 1, false, false );
+      deltas.add( producers( 60, 1 ), 1, false, false );
+   }(), "capacity is enforced" );
+
+   return host_test::result();
+}
@@ -0,0 +1,116 @@
+#include <pico.system/vote_weight.hpp>
+
+#include <host_test.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+/**
+ * Properties of the fixed-point vote weight kernel against the double-precision formula
+ * `staked * (1 - 7 * weeks_to_mature / lock_period_days) * 2^(weeks_since_epoch / 52)`.
+ */
+
+using picoiosystem::get_vote_weight;
+
+namespace {
+
+   constexpr int64_t max_stake        = ( 1ll << 62 ) - 1;
+   constexpr int64_t lock_period_days = 180;
+   constexpr int64_t max_weeks        = 52 * 200; // two centuries of epochs
+
+   double reference_weight( int64_t staked, int64_t weeks_to_mature, int64_t lock_days, int64_t weeks_since_epoch ) {
+      return double(staked) * ( 1.0 - double(7 * weeks_to_mature) / double(lock_days) )
+           * std::pow( 2.0, double(weeks_since_epoch) / 52.0 );
+   }
+
+   void test_table() {
+      for ( size_t k = 0; k < picoiosystem::vote_weight_week_multipliers.size(); ++k ) {
+         const double expected = std::ldexp( std::pow( 2.0, double(k) / 52.0 ), picoiosystem::vote_weight_fraction_bits );
+         HOST_CHECK( std::fabs( double(picoiosystem::vote_weight_week_multipliers[k]) - expected ) <= 0.5,
+                     "multiplier %zu", k );
+      }
+   }
+
+   void test_relative_error() {
+      std::mt19937_64 rng( 11 );
+      double max_error = 0;
+      for ( int i = 0; i < 200000; ++i ) {
+         const int64_t staked = int64_t( rng() >> ( 2 + rng() % 50 ) ) + 1;
+         const int64_t weeks_to_mature = rng() % ( lock_period_days / 7 + 1 );
+         const int64_t weeks = rng() % max_weeks;
+         const double expected = reference_weight( staked, weeks_to_mature, lock_period_days, weeks );
+         const double actual   = get_vote_weight( staked, weeks_to_mature, lock_period_days, weeks );
+         // integer maturity rounding loses at most one unit of the Q32 product
+         const double tolerance = 1e-9 * expected + std::ldexp( 1.0, int(weeks / 52) - 32 ) * 2;
+         const double error = std::fabs( actual - expected );
+         HOST_CHECK( error <= tolerance, "staked %lld weeks_to_mature %lld weeks %lld: %.17g vs %.17g",
+                     (long long)staked, (long long)weeks_to_mature, (long long)weeks, actual, expected );
+         if ( expected > 1e6 ) {
+            max_error = std::max( max_error, error / expected );
+         }
+      }
+      std::printf( "max relative error against std::pow for weights above 1e6: %.3g\n", max_error );
+      HOST_CHECK( max_error < 1e-9, "max relative error %.3g", max_error );
+   }
+
+   void test_year_boundaries() {
+      const int64_t stakes[] = { 1, 7, 10000, 123456789, int64_t(1) << 40, max_stake };
+      for ( const auto staked : stakes ) {
+         for ( int64_t year = 0; year * 52 < max_weeks; ++year ) {
+            const double weight = get_vote_weight( staked, 0, lock_period_days, year * 52 );
+            HOST_CHECK( weight == std::ldexp( double(staked), int(year) ), "staked %lld year %lld",
+                        (long long)staked, (long long)year );
+         }
+      }
+   }
+
+   void test_monotonicity() {
+      const int64_t stakes[] = { 1, 3, 10000, 987654321, int64_t(1) << 50 };
+      for ( const auto staked : stakes ) {
+         double prev = 0;
+         for ( int64_t weeks = 0; weeks < max_weeks; ++weeks ) {
+            const double weight = get_vote_weight( staked, 0, lock_period_days, weeks );
+            HOST_CHECK( prev <= weight, "epoch staked %lld weeks %lld", (long long)staked, (long long)weeks );
+            prev = weight;
+         }
+
+         for ( int64_t weeks = 0; weeks < max_weeks; weeks += 97 ) {
+            double prev_maturity = INFINITY;
+            for ( int64_t weeks_to_mature = 0; 7 * weeks_to_mature <= lock_period_days; ++weeks_to_mature ) {
+               const double weight = get_vote_weight( staked, weeks_to_mature, lock_period_days, weeks );
+               HOST_CHECK( weight <= prev_maturity, "maturity staked %lld weeks %lld weeks_to_mature %lld",
+                           (long long)staked, (long long)weeks, (long long)weeks_to_mature );
+               prev_maturity = weight;
+            }
+         }
+      }
+
+      std::mt19937_64 rng( 12 );
+      for ( int i = 0; i < 100000; ++i ) {
+         const int64_t staked = int64_t( rng() >> ( 2 + rng() % 50 ) );
+         const int64_t weeks  = rng() % max_weeks;
+         const int64_t weeks_to_mature = rng() % ( lock_period_days / 7 + 1 );
+         HOST_CHECK( get_vote_weight( staked, weeks_to_mature, lock_period_days, weeks )
+                     <= get_vote_weight( staked + 1, weeks_to_mature, lock_period_days, weeks ),
+                     "stake staked %lld", (long long)staked );
+      }
+   }
+
+   void test_invalid_input() {
+      HOST_CHECK_THROWS( get_vote_weight( 1, 0, 0, 0 ), "zero lock period" );
+      HOST_CHECK_THROWS( get_vote_weight( -1, 0, lock_period_days, 0 ), "negative stake" );
+      HOST_CHECK_THROWS( get_vote_weight( 1, lock_period_days, lock_period_days, 0 ), "maturity beyond lock period" );
+      HOST_CHECK( get_vote_weight( 0, 0, lock_period_days, 0 ) == 0, "zero stake" );
+   }
+
+} /// namespace
+
+int main() {
+   test_table();
+   test_relative_error();
+   test_year_boundaries();
+   test_monotonicity();
+   test_invalid_input();
+   return host_test::result();
+}
@@ -4,6 +4,7 @@
 #include <picoio/picoio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace picoiosystem {
    class system_contract;
@@ -27,6 +28,23 @@ namespace picoio {
       public:
          using contract::contract;
 
+         /**
+          * Transfer entry of a batch transfer.
+          *
+          * @details Entry defines one recipient of `transferbatch`:
+          * - `to` the account to be transferred to,
+          * - `amount` the amount of tokens in the symbol of the batch,
+          * - `memo` the memo string to accompany the transfer.
+          */
+         struct transfer_entry {
+            name     to;
+            int64_t  amount;
+            string   memo;
+
+            // explicit serialization macro is not necessary, used here only to improve compilation time
+            PICOLIB_SERIALIZE( transfer_entry, (to)(amount)(memo) )
+         };
+
          /**
           * Create action.
           *
@@ -73,6 +91,8 @@ namespace picoio {
           *
           * @details Allows `from` account to transfer to `to` account the `quantity` tokens.
           * One account is debited and the other is credited with quantity tokens.
+          * A transfer authorized only by the token contract itself is the notification of a `transferbatch`
+          * entry, it moves no tokens and only notifies `from` and `to`.
           *
           * @param from - the account to transfer from,
           * @param to - the account to be transferred to,
@@ -84,6 +104,25 @@ namespace picoio {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Transfer batch action.
+          *
+          * @details Allows `from` account to transfer tokens of symbol `sym` to several accounts at once.
+          * The symbol is looked up and `from` account is debited only once for the whole batch,
+          * every recipient is credited as in `transfer` action. Every entry is then announced by an inline
+          * `transfer` action which notifies `from` and the recipient, so existing `transfer` listeners
+          * receive batch transfers unchanged. Sending it requires `picoio.code` permission of the token
+          * contract in its `active` authority.
+          *
+          * @param from - the account to transfer from,
+          * @param sym - the symbol of the tokens to be transferred,
+          * @param transfers - the recipients, amounts and memos of the transfers.
+          */
+         [[picoio::action]]
+         void transferbatch( const name&                         from,
+                             const symbol&                       sym,
+                             const std::vector<transfer_entry>&  transfers );
          /**
           * Open action.
           *
@@ -166,6 +205,7 @@ namespace picoio {
          using issue_action = picoio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = picoio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = picoio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transferbatch_action = picoio::action_wrapper<"transferbatch"_n, &token::transferbatch>;
          using open_action = picoio::action_wrapper<"open"_n, &token::open>;
          using close_action = picoio::action_wrapper<"close"_n, &token::close>;
       private:
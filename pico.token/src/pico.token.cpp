@@ -28,12 +28,13 @@ void token::create( const name&   issuer,
 
 void token::issue( const name& to, const asset& quantity, const string& memo )
 {
-    auto sym = quantity.symbol;
+    const auto sym = quantity.symbol;
     check( sym.is_valid(), "invalid symbol name" );
     check( memo.size() <= 256, "memo has more than 256 bytes" );
 
-    stats statstable( get_self(), sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
+    const auto sym_code_raw = sym.code().raw();
+    stats statstable( get_self(), sym_code_raw );
+    auto existing = statstable.find( sym_code_raw );
     check( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
     const auto& st = *existing;
     check( to == st.issuer, "tokens can only be issued to issuer account" );
@@ -54,12 +55,13 @@ void token::issue( const name& to, const asset& quantity, const string& memo )
 
 void token::retire( const asset& quantity, const string& memo )
 {
-    auto sym = quantity.symbol;
+    const auto sym = quantity.symbol;
     check( sym.is_valid(), "invalid symbol name" );
     check( memo.size() <= 256, "memo has more than 256 bytes" );
 
-    stats statstable( get_self(), sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
+    const auto sym_code_raw = sym.code().raw();
+    stats statstable( get_self(), sym_code_raw );
+    auto existing = statstable.find( sym_code_raw );
     check( existing != statstable.end(), "token with symbol does not exist" );
     const auto& st = *existing;
 
@@ -81,12 +83,19 @@ void token::transfer( const name&    from,
                       const asset&   quantity,
                       const string&  memo )
 {
+    // balances of a `transferbatch` entry are already moved, its inline transfer only notifies the accounts
+    if( from != get_self() && has_auth( get_self() ) && !has_auth( from ) ) {
+       require_recipient( from );
+       require_recipient( to );
+       return;
+    }
+
     check( from != to, "cannot transfer to self" );
     require_auth( from );
     check( is_account( to ), "to account does not exist");
-    auto sym = quantity.symbol.code();
-    stats statstable( get_self(), sym.raw() );
-    const auto& st = statstable.get( sym.raw() );
+    const auto sym_code_raw = quantity.symbol.code().raw();
+    stats statstable( get_self(), sym_code_raw );
+    const auto& st = statstable.get( sym_code_raw );
 
     require_recipient( from );
     require_recipient( to );
@@ -102,12 +111,49 @@ void token::transfer( const name&    from,
     add_balance( to, quantity, payer );
 }
 
+void token::transferbatch( const name&                         from,
+                           const symbol&                       sym,
+                           const std::vector<transfer_entry>&  transfers )
+{
+    require_auth( from );
+    check( from != get_self(), "cannot batch transfer from token contract" );
+    check( !transfers.empty(), "no transfers in batch" );
+    const auto sym_code_raw = sym.code().raw();
+    stats statstable( get_self(), sym_code_raw );
+    const auto& st = statstable.get( sym_code_raw );
+    check( sym == st.supply.symbol, "symbol precision mismatch" );
+
+    // every entry is announced as a regular transfer, so existing `transfer` listeners see batch transfers too
+    transfer_action notify_transfer{ get_self(), { get_self(), "active"_n } };
+
+    asset total( 0, sym );
+    for( const auto& t : transfers ) {
+       check( from != t.to, "cannot transfer to self" );
+       check( is_account( t.to ), "to account does not exist");
+
+       const asset quantity( t.amount, sym );
+       check( quantity.is_valid(), "invalid quantity" );
+       check( quantity.amount > 0, "must transfer positive quantity" );
+       check( t.memo.size() <= 256, "memo has more than 256 bytes" );
+
+       total += quantity;
+       add_balance( t.to, quantity, has_auth( t.to ) ? t.to : from );
+       notify_transfer.send( from, t.to, quantity, t.memo );
+    }
+
+    sub_balance( from, total );
+}
+
 void token::sub_balance( const name& owner, const asset& value ) {
    accounts from_acnts( get_self(), owner.value );
 
-   const std::string err_str = "no balance object found for: "s + owner.to_string() + "; symbol: "s + value.symbol.code().to_string();
-   const auto& from = from_acnts.get( value.symbol.code().raw(), err_str.c_str() );
-   check( from.balance.amount >= value.amount, "overdrawn balance" );
+   const auto from = from_acnts.find( value.symbol.code().raw() );
+   if( from == from_acnts.end() ) {
+      // message is only formatted when the lookup fails
+      const std::string err_str = "no balance object found for: "s + owner.to_string() + "; symbol: "s + value.symbol.code().to_string();
+      check( false, err_str.c_str() );
+   }
+   check( from->balance.amount >= value.amount, "overdrawn balance" );
 
    from_acnts.modify( from, owner, [&]( auto& a ) {
          a.balance -= value;
@@ -0,0 +1,89 @@
+#include <pico.token/pico.token.hpp>
+
+#include <host_scenario.hpp>
+
+#include <vector>
+
+/**
+ * Runs pico.token scenario files, see host_scenario.hpp for the format.
+ *
+ * Every action of the contract is a command with its ABI arguments, assets are written as `<amount> <code>`
+ * and symbols as `<precision>,<code>`. `transferbatch` takes `<from> <symbol>` followed by `<to> <amount> <memo>`
+ * for every entry. `balance <owner> <asset>` checks a balance without being an action.
+ */
+
+using namespace picoio;
+
+namespace {
+
+   const name token_account = "pico.token"_n;
+
+   token make_token() {
+      return token( token_account, token_account, datastream<const char*>( nullptr, 0 ) );
+   }
+
+} /// namespace
+
+int main( int argc, char** argv ) {
+   if ( argc < 2 ) {
+      std::printf( "usage: %s <scenario>...\n", argv[0] );
+      return 1;
+   }
+
+   host::chain().accounts.insert( token_account );
+
+   host_scenario::runner runner;
+   runner.add( "create", []( auto& args ) {
+      const auto issuer = args.next_name();
+      make_token().create( issuer, args.next_asset() );
+   } );
+   runner.add( "issue", []( auto& args ) {
+      const auto to       = args.next_name();
+      const auto quantity = args.next_asset();
+      make_token().issue( to, quantity, args.next_string() );
+   } );
+   runner.add( "retire", []( auto& args ) {
+      const auto quantity = args.next_asset();
+      make_token().retire( quantity, args.next_string() );
+   } );
+   runner.add( "transfer", []( auto& args ) {
+      const auto from     = args.next_name();
+      const auto to       = args.next_name();
+      const auto quantity = args.next_asset();
+      make_token().transfer( from, to, quantity, args.next_string() );
+   } );
+   runner.add( "transferbatch", []( auto& args ) {
+      const auto from = args.next_name();
+      const auto sym  = args.next_symbol();
+      std::vector<token::transfer_entry> transfers;
+      while ( !args.empty() ) {
+         token::transfer_entry entry;
+         entry.to     = args.next_name();
+         entry.amount = args.next_int();
+         entry.memo   = args.next_string();
+         transfers.push_back( entry );
+      }
+      make_token().transferbatch( from, sym, transfers );
+   } );
+   runner.add( "open", []( auto& args ) {
+      const auto owner = args.next_name();
+      const auto sym   = args.next_symbol();
+      make_token().open( owner, sym, args.next_name() );
+   } );
+   runner.add( "close", []( auto& args ) {
+      const auto owner = args.next_name();
+      make_token().close( owner, args.next_symbol() );
+   } );
+   runner.add( "balance", []( auto& args ) {
+      const auto owner    = args.next_name();
+      const auto expected = args.next_asset();
+      const auto actual   = token::get_balance( token_account, owner, expected.symbol.code() );
+      check( actual == expected, "balance of " + owner.to_string() + " is " + std::to_string( actual.amount ) );
+   } );
+
+   int result = 0;
+   for ( int i = 1; i < argc; ++i ) {
+      result |= runner.run_file( argv[i] );
+   }
+   return result;
+}
@@ -0,0 +1,160 @@
+#include <pico.token/pico.token.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Compares N `transfer` actions with one `transferbatch` action of N entries.
+ *
+ * Both paths run the contract sources against the host stand-ins of multi_index and intrinsics, which count
+ * table accesses, `is_account` calls and notifications, including the ones of the inline `transfer` actions
+ * that announce batch entries. Host time is reported as well, it only tracks
+ * relative cost, WASM instruction counts have to be measured on a node.
+ */
+
+using namespace picoio;
+
+namespace {
+
+   const name   token_account = "pico.token"_n;
+   const name   issuer        = "issuer"_n;
+   const symbol sym( "PICO", 4 );
+
+   struct run_result {
+      uint64_t stat_reads     = 0;
+      uint64_t account_reads  = 0;
+      uint64_t account_writes = 0;
+      uint64_t is_account     = 0;
+      uint64_t notifications  = 0;
+      double   host_ns        = 0;
+   };
+
+   token make_token() {
+      return token( token_account, token_account, datastream<const char*>( nullptr, 0 ) );
+   }
+
+   void authorize( name account ) {
+      host::chain().authorizations = { account };
+   }
+
+   name recipient( char prefix, uint32_t i ) {
+      std::string str( 1, prefix );
+      for ( int k = 0; k < 6; ++k, i /= 26 ) {
+         str += char( 'a' + i % 26 );
+      }
+      return name( str );
+   }
+
+   uint64_t take_notifications() {
+      auto& notified = host::chain().notified;
+      const auto count = notified.size();
+      notified.clear();
+      return count;
+   }
+
+   template <typename Run>
+   run_result measure( Run&& run ) {
+      auto& chain = host::chain();
+      chain.reset_counters();
+      run_result result;
+
+      const auto start = std::chrono::steady_clock::now();
+      result.notifications = run();
+      result.host_ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+
+      const auto& stat     = chain.tables["stat"_n];
+      const auto& accounts = chain.tables["accounts"_n];
+      result.stat_reads     = stat.reads;
+      result.account_reads  = accounts.reads;
+      result.account_writes = accounts.stores + accounts.updates;
+      result.is_account     = chain.is_account_calls;
+      return result;
+   }
+
+   void print( const char* label, const run_result& r, uint32_t n ) {
+      std::printf( "%-14s %10llu %13llu %14llu %10llu %13llu %12.1f\n", label,
+                   (unsigned long long)r.stat_reads, (unsigned long long)r.account_reads,
+                   (unsigned long long)r.account_writes, (unsigned long long)r.is_account,
+                   (unsigned long long)r.notifications, r.host_ns / n );
+   }
+
+   bool expect( bool pred, const char* what ) {
+      if ( !pred ) {
+         std::printf( "FAILED: %s\n", what );
+      }
+      return pred;
+   }
+
+} /// namespace
+
+int main( int argc, char** argv ) {
+   const uint32_t n = argc > 1 ? std::stoul( argv[1] ) : 1000;
+
+   auto& chain = host::chain();
+   chain.accounts = { token_account, issuer };
+   for ( uint32_t i = 0; i < n; ++i ) {
+      chain.accounts.insert( recipient( 't', i ) );
+      chain.accounts.insert( recipient( 'b', i ) );
+   }
+
+   auto contract = make_token();
+   authorize( token_account );
+   contract.create( issuer, asset( asset::max_amount, sym ) );
+   authorize( issuer );
+   const int64_t issued = int64_t(n) * n * 10;
+   contract.issue( issuer, asset( issued, sym ), "" );
+
+   auto amount = []( uint32_t i ) { return int64_t( 1000 + i ); };
+
+   const auto single = measure( [&]() {
+      uint64_t notifications = 0;
+      for ( uint32_t i = 0; i < n; ++i ) {
+         authorize( issuer );
+         contract.transfer( issuer, recipient( 't', i ), asset( amount(i), sym ), "payout" );
+         notifications += take_notifications();
+      }
+      return notifications;
+   } );
+
+   std::vector<token::transfer_entry> entries;
+   entries.reserve( n );
+   for ( uint32_t i = 0; i < n; ++i ) {
+      entries.push_back( token::transfer_entry{ recipient( 'b', i ), amount(i), "payout" } );
+   }
+   const auto batch = measure( [&]() {
+      authorize( issuer );
+      contract.transferbatch( issuer, sym, entries );
+      // entries are announced by inline transfers which only notify, balances are already moved
+      return take_notifications() + host::run_inline_actions();
+   } );
+
+   std::printf( "%u transfers of %s\n\n", n, sym.code().to_string().c_str() );
+   std::printf( "%-14s %10s %13s %14s %10s %13s %12s\n", "path", "stat reads", "balance reads", "balance writes",
+                "is_account", "notifications", "host ns/xfer" );
+   print( "transfer x N", single, n );
+   print( "transferbatch", batch, n );
+
+   bool ok = true;
+   int64_t sent = 0;
+   for ( uint32_t i = 0; i < n; ++i ) {
+      const auto t = token::get_balance( token_account, recipient( 't', i ), sym.code() );
+      const auto b = token::get_balance( token_account, recipient( 'b', i ), sym.code() );
+      ok &= expect( t == asset( amount(i), sym ) && b == t, "recipient balances match" );
+      sent += 2 * amount(i);
+   }
+   ok &= expect( token::get_balance( token_account, issuer, sym.code() ) == asset( issued - sent, sym ), "sender balance" );
+   ok &= expect( batch.stat_reads == 1 && single.stat_reads == n, "stat lookups" );
+   ok &= expect( batch.notifications == single.notifications, "every transfer of the batch is notified as a transfer" );
+
+   // host tables are not rolled back on failure, so this goes last
+   try {
+      authorize( issuer );
+      contract.transferbatch( issuer, sym, { token::transfer_entry{ recipient( 'b', 0 ), issued, "overdrawn" } } );
+      ok &= expect( false, "overdrawn batch is rejected" );
+   } catch ( const check_failure& ) {
+   }
+
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <picoio/asset.hpp>
+#include <picoio/picoio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Scripted scenario runner for host builds of contracts.
+ *
+ * A runner registers the actions of a contract as commands and runs scenario files against the host stand-ins,
+ * one command per line, `#` starts a comment:
+ *
+ *    accounts <name>...         creates accounts on the host chain
+ *    auth <name>...             authorizations of the following commands
+ *    <command> <arg>...         runs a registered command, then the inline actions it sent
+ *    fail <command> <arg>...    same, the command has to fail a check
+ *    repeat <n> <line>          runs a line n times, `$i` in it is replaced by the index spelled with letters
+ *
+ * Arguments are separated by spaces, double quotes keep a string argument together. Host tables are not rolled
+ * back when a command fails, so a failing command must fail before it writes. Every command reports its number
+ * of calls, table accesses, rows added net of erased ones, notifications and host time percentiles. Host rows
+ * are not serialized, so rows stand in for RAM deltas and host time only tracks relative cost.
+ */
+namespace host_scenario {
+
+   using picoio::check;
+
+   class arguments {
+      public:
+         explicit arguments( std::vector<std::string> args ) : _args(std::move(args)) {}
+
+         bool empty()const { return _pos == _args.size(); }
+
+         std::string next_string() {
+            check( _pos < _args.size(), "missing argument" );
+            return _args[_pos++];
+         }
+
+         picoio::name next_name() { return picoio::name( next_string() ); }
+
+         int64_t next_int() { return std::stoll( next_string() ); }
+
+         // `<amount> <code>`, precision is the number of decimals of the amount
+         picoio::asset next_asset() {
+            const auto amount = next_string();
+            const auto code   = next_string();
+            const auto dot    = amount.find( '.' );
+            const uint8_t precision = dot == std::string::npos ? 0 : amount.size() - dot - 1;
+            std::string digits = amount;
+            if ( dot != std::string::npos ) {
+               digits.erase( dot, 1 );
+            }
+            return picoio::asset( std::stoll( digits ), picoio::symbol( code, precision ) );
+         }
+
+         // `<precision>,<code>`
+         picoio::symbol next_symbol() {
+            const auto str   = next_string();
+            const auto comma = str.find( ',' );
+            check( comma != std::string::npos, "symbol has to be given as <precision>,<code>" );
+            return picoio::symbol( str.substr( comma + 1 ), uint8_t( std::stoul( str.substr( 0, comma ) ) ) );
+         }
+
+      private:
+         std::vector<std::string> _args;
+         size_t                   _pos = 0;
+   };
+
+   using command = std::function<void( arguments& )>;
+
+   struct command_stats {
+      uint64_t            calls          = 0;
+      uint64_t            reads          = 0;
+      uint64_t            writes         = 0;
+      int64_t             rows           = 0;
+      uint64_t            notifications  = 0;
+      uint64_t            inline_actions = 0;
+      std::vector<double> host_ns;
+
+      double percentile( double p )const {
+         auto sorted = host_ns;
+         const size_t k = std::min( sorted.size() - 1, size_t( p * sorted.size() ) );
+         std::nth_element( sorted.begin(), sorted.begin() + k, sorted.end() );
+         return sorted[k];
+      }
+   };
+
+   class runner {
+      public:
+         void add( const std::string& name, command cmd ) { _commands[name] = std::move(cmd); }
+
+         // runs a scenario file and prints per-command totals, returns non-zero if any line did not behave
+         int run_file( const std::string& path ) {
+            std::ifstream in( path );
+            if ( !in ) {
+               std::printf( "cannot open scenario %s\n", path.c_str() );
+               return 1;
+            }
+            std::string line;
+            for ( uint32_t number = 1; std::getline( in, line ); ++number ) {
+               run_line( line, path, number );
+            }
+            print( path );
+            return _failures ? 1 : 0;
+         }
+
+      private:
+         static std::vector<std::string> split( const std::string& line ) {
+            std::vector<std::string> tokens;
+            for ( size_t i = 0; i < line.size(); ) {
+               if ( line[i] == ' ' || line[i] == '\t' ) {
+                  ++i;
+               } else if ( line[i] == '#' ) {
+                  break;
+               } else if ( line[i] == '"' ) {
+                  const auto end = line.find( '"', i + 1 );
+                  tokens.push_back( line.substr( i + 1, end == std::string::npos ? std::string::npos : end - i - 1 ) );
+                  i = end == std::string::npos ? line.size() : end + 1;
+               } else {
+                  const auto end = line.find_first_of( " \t", i );
+                  tokens.push_back( line.substr( i, end == std::string::npos ? std::string::npos : end - i ) );
+                  i = end == std::string::npos ? line.size() : end;
+               }
+            }
+            return tokens;
+         }
+
+         static std::string letters( uint32_t i ) {
+            std::string str;
+            for ( int k = 0; k < 4; ++k, i /= 26 ) {
+               str += char( 'a' + i % 26 );
+            }
+            return str;
+         }
+
+         void run_line( const std::string& line, const std::string& path, uint32_t number ) {
+            auto tokens = split( line );
+            if ( tokens.empty() ) {
+               return;
+            }
+            if ( tokens[0] == "repeat" && tokens.size() > 2 ) {
+               const auto count = std::stoul( tokens[1] );
+               const auto count_end = line.find( tokens[1], line.find( "repeat" ) + 6 ) + tokens[1].size();
+               const auto body  = line.substr( count_end );
+               for ( uint32_t i = 0; i < count; ++i ) {
+                  std::string expanded = body;
+                  for ( auto pos = expanded.find( "$i" ); pos != std::string::npos; pos = expanded.find( "$i", pos ) ) {
+                     expanded.replace( pos, 2, letters( i ) );
+                  }
+                  run_line( expanded, path, number );
+               }
+               return;
+            }
+            if ( tokens[0] == "accounts" ) {
+               for ( size_t i = 1; i < tokens.size(); ++i ) {
+                  picoio::host::chain().accounts.insert( picoio::name( tokens[i] ) );
+               }
+               return;
+            }
+            if ( tokens[0] == "auth" ) {
+               auto& auths = picoio::host::chain().authorizations;
+               auths.clear();
+               for ( size_t i = 1; i < tokens.size(); ++i ) {
+                  auths.insert( picoio::name( tokens[i] ) );
+               }
+               return;
+            }
+
+            const bool expect_failure = tokens[0] == "fail";
+            if ( expect_failure ) {
+               tokens.erase( tokens.begin() );
+            }
+            const auto name = tokens.empty() ? std::string() : tokens[0];
+            auto cmd = _commands.find( name );
+            if ( cmd == _commands.end() ) {
+               report( path, number, "unknown command " + name );
+               return;
+            }
+            arguments args( std::vector<std::string>( tokens.begin() + 1, tokens.end() ) );
+            run_command( name, cmd->second, args, expect_failure, path, number );
+         }
+
+         void run_command( const std::string& name, const command& cmd, arguments& args, bool expect_failure,
+                           const std::string& path, uint32_t number ) {
+            auto& chain = picoio::host::chain();
+            const auto authorizations = chain.authorizations;
+            chain.reset_counters();
+
+            std::string error;
+            uint64_t notifications = 0;
+            const auto start = std::chrono::steady_clock::now();
+            try {
+               cmd( args );
+               check( args.empty(), "too many arguments" );
+               notifications = chain.notified.size();
+               notifications += picoio::host::run_inline_actions();
+            } catch ( const picoio::check_failure& e ) {
+               error = e.what();
+               chain.pending_inline_actions.clear();
+            }
+            const auto elapsed = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+            // inline actions run with their own authorizations
+            chain.authorizations = authorizations;
+
+            if ( expect_failure && error.empty() ) {
+               report( path, number, name + " did not fail" );
+            } else if ( !expect_failure && !error.empty() ) {
+               report( path, number, name + ": " + error );
+            }
+
+            auto& stats = _stats[name];
+            ++stats.calls;
+            for ( const auto& t : chain.tables ) {
+               stats.reads  += t.second.reads;
+               stats.writes += t.second.stores + t.second.updates + t.second.erases;
+               stats.rows   += int64_t( t.second.stores ) - int64_t( t.second.erases );
+            }
+            stats.notifications  += notifications;
+            stats.inline_actions += chain.inline_actions;
+            stats.host_ns.push_back( elapsed );
+         }
+
+         void report( const std::string& path, uint32_t number, const std::string& what ) {
+            ++_failures;
+            std::printf( "%s:%u: %s\n", path.c_str(), number, what.c_str() );
+         }
+
+         void print( const std::string& path )const {
+            std::printf( "%s\n\n%-16s %8s %12s %12s %10s %14s %10s %10s %10s\n", path.c_str(), "command", "calls",
+                         "reads/call", "writes/call", "rows/call", "notifications", "inline", "p50 ns", "p99 ns" );
+            for ( const auto& s : _stats ) {
+               const double calls = double(s.second.calls);
+               std::printf( "%-16s %8llu %12.1f %12.1f %10.2f %14.1f %10.1f %10.0f %10.0f\n", s.first.c_str(),
+                            (unsigned long long)s.second.calls, s.second.reads / calls, s.second.writes / calls,
+                            s.second.rows / calls, s.second.notifications / calls, s.second.inline_actions / calls,
+                            s.second.percentile( 0.5 ), s.second.percentile( 0.99 ) );
+            }
+         }
+
+         std::map<std::string, command>       _commands;
+         std::map<std::string, command_stats> _stats;
+         uint32_t                             _failures = 0;
+   };
+
+} /// namespace host_scenario
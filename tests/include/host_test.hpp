@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdio>
+
+/**
+ * Minimal assertion helpers for host tests, a test binary returns non-zero if any check failed.
+ */
+namespace host_test {
+
+   inline int& failures() {
+      static int count = 0;
+      return count;
+   }
+
+   inline int result() {
+      if ( failures() ) {
+         std::printf( "%d check(s) failed\n", failures() );
+      }
+      return failures() ? 1 : 0;
+   }
+
+} /// namespace host_test
+
+#define HOST_CHECK( cond, ... )                                        \
+   do {                                                                \
+      if ( !( cond ) ) {                                               \
+         ++host_test::failures();                                      \
+         std::printf( "%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond ); \
+         std::printf( __VA_ARGS__ );                                   \
+         std::printf( "\n" );                                          \
+      }                                                                \
+   } while ( 0 )
+
+#define HOST_CHECK_THROWS( expr, ... )                                 \
+   do {                                                                \
+      bool thrown = false;                                             \
+      try { expr; } catch ( const picoio::check_failure& ) { thrown = true; } \
+      HOST_CHECK( thrown, __VA_ARGS__ );                               \
+   } while ( 0 )
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <picoio/check.hpp>
+#include <picoio/serialize.hpp>
+
+#include <string>
+#include <string_view>
+
+namespace picoio {
+
+   /**
+    * Host stand-in of symbol code, same encoding as on chain.
+    */
+   class symbol_code {
+      public:
+         constexpr symbol_code() = default;
+         constexpr explicit symbol_code( uint64_t raw ) : value(raw) {}
+         constexpr explicit symbol_code( std::string_view str ) {
+            if ( str.size() > 7 ) {
+               check( false, "string is too long to be a valid symbol_code" );
+            }
+            for ( auto it = str.rbegin(); it != str.rend(); ++it ) {
+               if ( *it < 'A' || *it > 'Z' ) {
+                  check( false, "only uppercase letters allowed in symbol_code string" );
+               }
+               value <<= 8;
+               value |= *it;
+            }
+         }
+
+         constexpr bool is_valid()const {
+            auto sym = value;
+            for ( int i = 0; i < 7; ++i ) {
+               const char c = char(sym & 0xFF);
+               if ( !( 'A' <= c && c <= 'Z' ) ) return false;
+               sym >>= 8;
+               if ( !( sym & 0xFF ) ) {
+                  do {
+                     sym >>= 8;
+                     if ( ( sym & 0xFF ) ) return false;
+                     ++i;
+                  } while ( i < 7 );
+               }
+            }
+            return true;
+         }
+
+         constexpr uint64_t raw()const { return value; }
+
+         std::string to_string()const {
+            std::string str;
+            for ( auto v = value; v; v >>= 8 ) {
+               str += char(v & 0xFF);
+            }
+            return str;
+         }
+
+         friend constexpr bool operator==( const symbol_code& a, const symbol_code& b ) { return a.value == b.value; }
+         friend constexpr bool operator!=( const symbol_code& a, const symbol_code& b ) { return a.value != b.value; }
+
+      private:
+         uint64_t value = 0;
+   };
+
+   /**
+    * Host stand-in of symbol, precision in the low byte and code above it.
+    */
+   class symbol {
+      public:
+         constexpr symbol() = default;
+         constexpr symbol( symbol_code sc, uint8_t precision ) : value( sc.raw() << 8 | precision ) {}
+         constexpr symbol( std::string_view ss, uint8_t precision ) : symbol( symbol_code(ss), precision ) {}
+
+         constexpr bool        is_valid()const { return code().is_valid(); }
+         constexpr uint8_t     precision()const { return value & 0xFF; }
+         constexpr symbol_code code()const { return symbol_code{ value >> 8 }; }
+         constexpr uint64_t    raw()const { return value; }
+
+         friend constexpr bool operator==( const symbol& a, const symbol& b ) { return a.value == b.value; }
+         friend constexpr bool operator!=( const symbol& a, const symbol& b ) { return a.value != b.value; }
+
+      private:
+         uint64_t value = 0;
+   };
+
+   /**
+    * Host stand-in of asset with the same range and symbol checks as on chain.
+    */
+   struct asset {
+      static constexpr int64_t max_amount = ( 1LL << 62 ) - 1;
+
+      int64_t amount = 0;
+      picoio::symbol symbol;
+
+      asset() = default;
+      asset( int64_t a, picoio::symbol s ) : amount(a), symbol(s) {
+         check( is_amount_within_range(), "magnitude of asset amount must be less than 2^62" );
+         check( symbol.is_valid(), "invalid symbol name" );
+      }
+
+      bool is_amount_within_range()const { return -max_amount <= amount && amount <= max_amount; }
+      bool is_valid()const { return is_amount_within_range() && symbol.is_valid(); }
+
+      asset& operator+=( const asset& a ) {
+         check( a.symbol == symbol, "attempt to add asset with different symbol" );
+         amount += a.amount;
+         check( -max_amount <= amount, "addition underflow" );
+         check( amount <= max_amount, "addition overflow" );
+         return *this;
+      }
+
+      asset& operator-=( const asset& a ) {
+         check( a.symbol == symbol, "attempt to subtract asset with different symbol" );
+         amount -= a.amount;
+         check( -max_amount <= amount, "subtraction underflow" );
+         check( amount <= max_amount, "subtraction overflow" );
+         return *this;
+      }
+
+      friend asset operator+( asset a, const asset& b ) { return a += b; }
+      friend asset operator-( asset a, const asset& b ) { return a -= b; }
+      friend bool operator==( const asset& a, const asset& b ) { return a.symbol == b.symbol && a.amount == b.amount; }
+      friend bool operator!=( const asset& a, const asset& b ) { return !( a == b ); }
+   };
+
+} /// namespace picoio
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <picoio/types.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace picoio {
+
+   /**
+    * Host stand-in of the assertion intrinsic, a failed check throws instead of aborting the transaction.
+    */
+   struct check_failure : std::runtime_error {
+      using std::runtime_error::runtime_error;
+   };
+
+   inline void check( bool pred, const char* msg ) {
+      if ( !pred ) {
+         throw check_failure( msg );
+      }
+   }
+
+   inline void check( bool pred, const std::string& msg ) {
+      if ( !pred ) {
+         throw check_failure( msg );
+      }
+   }
+
+} /// namespace picoio
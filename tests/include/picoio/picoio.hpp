@@ -0,0 +1,254 @@
+#pragma once
+
+#include <picoio/asset.hpp>
+#include <picoio/check.hpp>
+#include <picoio/name.hpp>
+#include <picoio/serialize.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <set>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace picoio {
+
+   /**
+    * Host chain state the contract runs against: existing accounts, authorizations of the current action,
+    * notified accounts and counters of database and intrinsic calls.
+    */
+   namespace host {
+
+      struct table_counters {
+         uint64_t reads   = 0;
+         uint64_t stores  = 0;
+         uint64_t updates = 0;
+         uint64_t erases  = 0;
+      };
+
+      struct chain_state {
+         std::set<name>                   accounts;
+         std::set<name>                   authorizations;
+         std::vector<name>                notified;
+         std::map<name, table_counters>   tables;
+         std::deque<std::function<void()>> pending_inline_actions;
+         uint64_t                         is_account_calls = 0;
+         uint64_t                         inline_actions   = 0;
+
+         void reset_counters() {
+            tables.clear();
+            notified.clear();
+            is_account_calls = 0;
+            inline_actions   = 0;
+         }
+      };
+
+      inline chain_state& chain() {
+         static chain_state state;
+         return state;
+      }
+
+      template <typename T>
+      std::map<uint64_t, T>& table_rows( name code, name table, uint64_t scope ) {
+         static std::map<std::tuple<uint64_t, uint64_t, uint64_t>, std::map<uint64_t, T>> tables;
+         return tables[{ code.value, table.value, scope }];
+      }
+
+      /**
+       * Executes queued inline actions in the order they were sent, including the ones they send themselves,
+       * and returns the number of accounts notified by them. Every action runs with the authorizations it was sent with.
+       */
+      inline uint64_t run_inline_actions() {
+         auto& state = chain();
+         uint64_t notifications = 0;
+         while ( !state.pending_inline_actions.empty() ) {
+            auto next = std::move( state.pending_inline_actions.front() );
+            state.pending_inline_actions.pop_front();
+            state.notified.clear();
+            next();
+            notifications += state.notified.size();
+            state.notified.clear();
+         }
+         return notifications;
+      }
+
+   } /// namespace host
+
+   inline void require_auth( name n ) {
+      check( host::chain().authorizations.count( n ) > 0, "missing authority of " + n.to_string() );
+   }
+
+   inline bool has_auth( name n ) {
+      return host::chain().authorizations.count( n ) > 0;
+   }
+
+   inline bool is_account( name n ) {
+      ++host::chain().is_account_calls;
+      return host::chain().accounts.count( n ) > 0;
+   }
+
+   inline void require_recipient( name n ) {
+      auto& notified = host::chain().notified;
+      if ( std::find( notified.begin(), notified.end(), n ) == notified.end() ) {
+         notified.push_back( n );
+      }
+   }
+
+   template <typename T>
+   class datastream {
+      public:
+         datastream( T start, size_t size ) : _start(start), _size(size) {}
+      private:
+         T      _start;
+         size_t _size;
+   };
+
+   class contract {
+      public:
+         contract( name self, name first_receiver, datastream<const char*> ds )
+         :_self(self), _first_receiver(first_receiver), _ds(ds) {}
+
+         name get_self()const { return _self; }
+         name get_first_receiver()const { return _first_receiver; }
+
+      protected:
+         name                    _self;
+         name                    _first_receiver;
+         datastream<const char*> _ds;
+   };
+
+   struct permission_level {
+      name actor;
+      name permission;
+   };
+
+   template <typename T>
+   struct action_handler_traits;
+
+   template <typename Contract, typename... Params>
+   struct action_handler_traits<void (Contract::*)( Params... )> {
+      using contract_type = Contract;
+      using arguments     = std::tuple<std::decay_t<Params>...>;
+   };
+
+   /**
+    * Host stand-in of action_wrapper, `send` queues the action for `host::run_inline_actions`.
+    */
+   template <name::raw Name, auto Action>
+   struct action_wrapper {
+      action_wrapper( name code, std::vector<permission_level> perms ) : code_name(code), permissions(std::move(perms)) {}
+      action_wrapper( name code, permission_level perm ) : code_name(code), permissions({ perm }) {}
+
+      template <typename... Args>
+      void send( Args&&... args ) const {
+         using traits = action_handler_traits<decltype(Action)>;
+         ++host::chain().inline_actions;
+         host::chain().pending_inline_actions.push_back(
+            [code = code_name, perms = permissions, data = typename traits::arguments( std::forward<Args>(args)... )]() {
+               auto& auths = host::chain().authorizations;
+               auths.clear();
+               for ( const auto& p : perms ) {
+                  auths.insert( p.actor );
+               }
+               typename traits::contract_type receiver( code, code, datastream<const char*>( nullptr, 0 ) );
+               std::apply( [&]( const auto&... a ) { ( receiver.*Action )( a... ); }, data );
+            } );
+      }
+
+      name                          code_name;
+      std::vector<permission_level> permissions;
+   };
+
+   static constexpr name same_payer{};
+
+   /**
+    * Host stand-in of multi_index without secondary indices, rows live in memory and every access is counted.
+    */
+   template <name::raw TableName, typename T>
+   class multi_index {
+      using rows_type = std::map<uint64_t, T>;
+
+      public:
+         class const_iterator {
+            public:
+               using iterator_category = std::bidirectional_iterator_tag;
+               using value_type        = T;
+               using difference_type   = std::ptrdiff_t;
+               using pointer           = const T*;
+               using reference         = const T&;
+
+               const_iterator() = default;
+               explicit const_iterator( typename rows_type::const_iterator it ) : _it(it) {}
+
+               const T& operator*()const { return _it->second; }
+               const T* operator->()const { return &_it->second; }
+               const_iterator& operator++() { ++_it; return *this; }
+               const_iterator& operator--() { --_it; return *this; }
+               bool operator==( const const_iterator& other )const { return _it == other._it; }
+               bool operator!=( const const_iterator& other )const { return _it != other._it; }
+
+            private:
+               friend class multi_index;
+               typename rows_type::const_iterator _it;
+         };
+
+         multi_index( name code, uint64_t scope )
+         :_rows(host::table_rows<T>( code, name(TableName), scope )) {}
+
+         const_iterator begin()const { return const_iterator( _rows.cbegin() ); }
+         const_iterator end()const { return const_iterator( _rows.cend() ); }
+
+         const_iterator find( uint64_t primary )const {
+            ++counters().reads;
+            return const_iterator( _rows.find( primary ) );
+         }
+
+         const T& get( uint64_t primary, const char* error_msg = "unable to find key" )const {
+            auto it = find( primary );
+            check( it != end(), error_msg );
+            return *it;
+         }
+
+         template <typename Lambda>
+         const_iterator emplace( name payer, Lambda&& constructor ) {
+            ++counters().stores;
+            T obj{};
+            constructor( obj );
+            const auto pk = obj.primary_key();
+            check( _rows.count( pk ) == 0, "could not insert object, most likely a uniqueness constraint was violated" );
+            return const_iterator( _rows.emplace( pk, std::move(obj) ).first );
+         }
+
+         template <typename Lambda>
+         void modify( const_iterator itr, name payer, Lambda&& updater ) {
+            check( itr != end(), "cannot pass end iterator to modify" );
+            ++counters().updates;
+            auto& obj = const_cast<T&>( *itr );
+            const auto pk = obj.primary_key();
+            updater( obj );
+            check( pk == obj.primary_key(), "updater cannot change primary key when modifying an object" );
+         }
+
+         template <typename Lambda>
+         void modify( const T& obj, name payer, Lambda&& updater ) {
+            modify( const_iterator( _rows.find( obj.primary_key() ) ), payer, std::forward<Lambda>(updater) );
+         }
+
+         const_iterator erase( const_iterator itr ) {
+            check( itr != end(), "cannot pass end iterator to erase" );
+            ++counters().erases;
+            return const_iterator( _rows.erase( itr._it ) );
+         }
+
+      private:
+         static host::table_counters& counters() { return host::chain().tables[name(TableName)]; }
+
+         rows_type& _rows;
+   };
+
+} /// namespace picoio
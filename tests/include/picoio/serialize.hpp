@@ -0,0 +1,5 @@
+#pragma once
+
+// host builds do not serialize, tables are kept as objects
+#define PICOLIB_SERIALIZE( TYPE, MEMBERS )
+#define PICOLIB_SERIALIZE_DERIVED( TYPE, BASE, MEMBERS )
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+typedef unsigned __int128 uint128_t;
+typedef __int128          int128_t;